@@ -0,0 +1,53 @@
+/*
+  Bluetooth.h
+  Kyzer Bowen, Tyce Miller
+
+  HC-05 Bluetooth link on the Mega's hardware USART2. SoftwareSerial bit bangs every byte with interrupts off
+  (about 1 ms per byte at 9600 baud), which held off the encoder and step interrupts while the robot was being
+  driven. The USART shifts the bits out in hardware and its interrupts only move one byte in or out of a ring
+  buffer, so talking over Bluetooth no longer delays encoder ticks or steps.
+  USART1 (pins 18 and 19) is taken by the encoders, so the module uses USART2. Serial2 must not be used with this,
+  the two would own the same interrupts.
+  ATmega2560 datasheet, section 22 (USART)
+
+  digital pin 16 (TX2) - RX on the HC-05
+  digital pin 17 (RX2) - TX on the HC-05
+
+  The primary functions created are
+  begin - set the baud rate (U2X for accuracy above 9600) and turn on the USART and its interrupts
+  available, read, peek - receive side, like Serial
+  write, availableForWrite, flush - transmit side, print() and println() come from Stream
+  rxOverflows - bytes lost because the receive ring was full
+  rxOverruns - bytes the USART lost because its interrupt was held off too long
+
+  Key variables
+  BT_RX_SIZE, BT_TX_SIZE - ring buffer sizes (powers of 2, at most 256)
+  BT_DEFAULT_BAUD - HC-05 data mode speed out of the box, change it with the AT+UART command
+*/
+
+#ifndef BLUETOOTH_H
+#define BLUETOOTH_H
+
+#include <Arduino.h>
+
+#define BT_RX_SIZE 64            //bytes, must be a power of 2
+#define BT_TX_SIZE 64            //bytes, must be a power of 2
+#define BT_DEFAULT_BAUD 9600     //HC-05 default
+
+class UsartStream : public Stream {
+public:
+  void begin(unsigned long baud);
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t byte);
+  int availableForWrite();
+  void flush();
+  unsigned int rxOverflows();
+  unsigned int rxOverruns();
+  using Print::write;   //write(buffer, size) and write(string)
+};
+
+extern UsartStream bluetooth;   //the HC-05 on USART2
+
+#endif
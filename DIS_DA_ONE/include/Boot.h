@@ -0,0 +1,84 @@
+/*
+  Boot.h
+  Kyzer Bowen, Tyce Miller
+
+  Staged startup. setup() only starts each subsystem, loop() finishes them with boot_service() in main.cpp, so the
+  slow parts (the MPU6050 reset and gyro zero, waiting for the serial port) run side by side and nothing blocks.
+  Each stage ends READY or FAILED and a failed stage never stops the others: without the IMU the odometry runs on
+  the encoders alone. Commands are taken once the steppers, encoders and comms are up and the hold time has passed,
+  the IMU finishes on its own and starts its gyro zero over whenever the wheels move during it.
+
+  FAST_BOOT (default 1) leaves out the cosmetic waits, the robot takes commands about 1 ms after reset.
+  Build with -D FAST_BOOT=0 for the LED check at startup and BOOT_HOLD_MS before commands are taken, time to set
+  the robot down after a reset.
+
+  The primary functions created are
+  begin - time zero of the boot, read and clear the reset cause
+  start, finish - a stage has started, a stage is done (ready or failed)
+  done - every stage is done
+  commandsReady - the stages commands need are ready and the hold has passed
+  print - stage states, the time each one took and the reset cause
+
+  Key variables
+  BootStage - one entry per subsystem
+  BootState - where a stage is
+  resetCause - MCUSR at reset, power on, external (reset button, upload), brown-out or watchdog
+*/
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <Arduino.h>
+
+#ifndef FAST_BOOT
+#define FAST_BOOT 1                 //build with -D FAST_BOOT=0 for the LED check and the hold
+#endif
+
+#if FAST_BOOT
+#define BOOT_LED_MS 0               //no LED check
+#define BOOT_HOLD_MS 0              //commands are taken as soon as the stages they need are ready
+#else
+#define BOOT_LED_MS 500             //all LEDs on at startup
+#define BOOT_HOLD_MS 7500           //time before commands are taken (was delay(5000) and delay(pauseTime))
+#endif
+
+#define BOOT_SERIAL_TIMEOUT_MS 1000 //longest wait for the serial port (boards with native USB, the Mega is ready at once)
+#define BOOT_IMU_TIMEOUT_MS 3000    //longest wait for the gyro zero with the robot still
+
+enum BootStage {
+  BOOT_STEPPERS,     //step engine and drivers
+  BOOT_ENCODERS,     //encoder interrupts, odometry and the motion queue
+  BOOT_COMMS,        //serial monitor, Bluetooth and the command parsers
+  BOOT_IMU,          //MPU6050 found, set up and its gyro zero taken
+  BOOT_STAGES
+};
+
+enum BootState {
+  BOOT_WAITING,      //not started
+  BOOT_RUNNING,      //started, not done
+  BOOT_READY,        //up
+  BOOT_FAILED        //gave up, the robot runs without it
+};
+
+class BootSequence {
+public:
+  void begin();
+  void start(BootStage stage);
+  void finish(BootStage stage, bool ok);
+  BootState state(BootStage stage) { return states[stage]; }
+  unsigned long elapsed() { return millis() - startMs; }
+  bool done();
+  bool commandsReady();
+  void print(Print &port);
+
+  uint8_t resetCause;                     //MCUSR at reset
+
+private:
+  BootState states[BOOT_STAGES];
+  unsigned long doneMs[BOOT_STAGES];      //ms after begin() each stage finished
+  unsigned long startMs;                  //millis() at begin()
+};
+
+extern BootSequence boot;   //the one startup
+
+#endif
@@ -0,0 +1,76 @@
+/*
+  Calibration.h
+  Kyzer Bowen, Tyce Miller
+
+  Wheel geometry calibration, fitted from drive trials and kept in EEPROM so it survives a reflash.
+  The constants in RobotConfig.h are what the robot was designed as, the calibration is what it really is: the
+  effective wheel circumference (tire squash and wear), the effective track width (where the tires really touch)
+  and the encoder edges per wheel rotation. load() puts the stored values into drive (FixedKinematics.h) at boot,
+  so every motion function and the odometry use them without a rebuild.
+
+  Trials (the commands are in main.cpp)
+  calfwd cm;      - drive straight, the encoder ticks against the steps give the ticks per rotation
+  caldist mm;     - the distance the last calfwd really covered, measured on the floor, gives the circumference
+  calspin turns;  - spin in place, the gyro angle against the wheel travel gives the track width
+  calturn deg;    - the angle the last calspin really turned, for a robot without a working gyro
+  calsave;        - write the values to EEPROM, caldef; - back to RobotConfig.h and erase the EEPROM copy
+  calshow;        - print the values in use
+  A fit that lands more than CALIBRATION_LIMIT away from the RobotConfig.h value is refused as a bad trial.
+
+  The primary functions created are
+  load - read the EEPROM record and use it, false (and RobotConfig.h values) when there is none or it is damaged
+  save - write the values in use to EEPROM
+  reset - go back to RobotConfig.h and erase the EEPROM record
+  straightTrial, fitDistance - fit the ticks per rotation and the circumference from a straight run
+  spinTrial, fitSpin - keep the steps of a spin whose angle comes later (calturn), fit the track width from a spin
+  print - show the values in use
+
+  Key variables
+  CalibrationRecord - EEPROM layout, a magic number, the three values and a CRC-16/XMODEM over them
+  CALIBRATION_ADDRESS - EEPROM address of the record
+*/
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Arduino.h>
+
+#define CALIBRATION_ADDRESS 0      //EEPROM byte address of the record
+#define CALIBRATION_MAGIC 0xCA1B   //marks a record written by save()
+#define CALIBRATION_LIMIT 0.2      //largest fraction a fit may move a value from RobotConfig.h
+
+//calibration as it sits in EEPROM
+struct CalibrationRecord {
+  uint16_t magic;           //CALIBRATION_MAGIC
+  float circumference;      //cm per wheel rotation
+  float trackWidth;         //cm between the tire contact points
+  float ticksPerRotation;   //encoder edges per wheel rotation
+  uint16_t crc;             //CRC-16/XMODEM of everything before it
+};
+
+class Calibration {
+public:
+  bool load();
+  void save();
+  void reset();
+  bool straightTrial(long steps, const long ticks[2]);
+  bool fitDistance(float cm);
+  void spinTrial(long steps);
+  bool fitSpin(long steps, float degrees);
+  void print(Print &port);
+
+  float circumference;      //cm per wheel rotation in use
+  float trackWidth;         //cm in use
+  float ticksPerRotation;   //encoder edges per wheel rotation in use
+
+private:
+  void apply();
+
+  long straightSteps;       //steps of the last straight trial, 0 when there was none
+  long spinSteps;           //steps of the last spin trial, 0 when there was none
+  bool stored;              //the values in use are the ones in EEPROM
+};
+
+extern Calibration calibration;   //the one set of geometry values
+
+#endif
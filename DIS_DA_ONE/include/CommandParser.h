@@ -0,0 +1,70 @@
+/*
+  CommandParser.h
+  Kyzer Bowen, Tyce Miller
+
+  Parser for the remote control commands that come in over the serial monitor or Bluetooth.
+  A command is a verb and up to COMMAND_MAX_ARGS whole numbers separated by spaces or commas, ending with ';'
+    forward 30;   spin 1,90;   goto 50 -20;   stop;
+  Bytes are handed over one at a time as they arrive and are parsed on the spot (the verb into a small fixed buffer,
+  the numbers straight into the argument array), so no String or heap is used and each byte costs the same small
+  amount of work. At the ';' the verb is looked up in a table of commands and its function is called.
+  Anything that does not fit (long verb, too many numbers, stray characters) marks the command bad and the rest of
+  it is skipped up to the ';'.
+
+  The primary functions created are
+  begin - give the parser its command table
+  feed - parse one byte, returns what happened when it was a ';'
+  poll - feed the bytes waiting on a serial port up to the end of the next command
+
+  Key variables
+  Command - one table entry: verb, number of arguments it needs, function to call
+  CommandResult - COMMAND_NONE (still in the middle of a command), COMMAND_DONE, COMMAND_UNKNOWN, COMMAND_BAD
+  COMMAND_VERB_SIZE - longest verb plus one
+*/
+
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <Arduino.h>
+
+#define COMMAND_VERB_SIZE 8    //verbs up to 7 letters
+#define COMMAND_MAX_ARGS 3     //numbers per command
+
+enum CommandResult {
+  COMMAND_NONE,       //no ';' yet
+  COMMAND_DONE,       //command found and run
+  COMMAND_UNKNOWN,    //verb not in the table
+  COMMAND_BAD         //wrong number of arguments or a character that does not belong
+};
+
+//one entry of the command table
+struct Command {
+  const char *verb;                  //lower case name
+  uint8_t args;                      //number of arguments it needs
+  void (*run)(const int *args);      //function to call with them
+};
+
+class CommandParser {
+public:
+  void begin(const Command *table, uint8_t count);
+  CommandResult feed(char c);
+  CommandResult poll(Stream &port);
+
+private:
+  CommandResult finish();
+  void endNumber();
+  void restart();
+
+  const Command *commands;           //command table
+  uint8_t commandCount;              //entries in the table
+  char verb[COMMAND_VERB_SIZE];      //verb so far, 0 terminated
+  uint8_t verbLength;
+  int args[COMMAND_MAX_ARGS];        //numbers so far
+  uint8_t argCount;                  //numbers started, the last one may still be growing
+  bool inVerb;                       //the last character was part of the verb
+  bool inNumber;                     //the last character was part of a number
+  bool negative;                     //the number being read started with '-'
+  bool bad;                          //skip to the ';'
+};
+
+#endif
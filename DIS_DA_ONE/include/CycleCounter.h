@@ -0,0 +1,34 @@
+/*
+  CycleCounter.h
+  Kyzer Bowen, Tyce Miller
+
+  Timer5 as a free running CPU cycle counter for the timing probes (Probes.h) and the profiling build (Profiler.h).
+  Timer5 counts at the CPU clock, 62.5 ns per count. 16 bits are enough to time an ISR (it wraps every 4.1 ms), the
+  foreground gets 32 bits from an overflow count kept by a small overflow ISR, which costs about 1 us every 4.1 ms.
+  Nothing else in the firmware uses Timer5, analogWrite() on pins 44 to 46 is not available once it is started.
+
+  The primary functions created are
+  cycleCounterBegin - start Timer5
+  cycleCount - 32 bit cycle count, wraps after 268 s so only differences mean anything
+  cycleCount16 - the low 16 bits straight from TCNT5, for ISRs
+
+  Key variables
+  CYCLES_PER_US, CYCLES_PER_MS - CPU cycles in a microsecond and a millisecond
+*/
+
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <Arduino.h>
+
+#define CYCLES_PER_US (F_CPU / 1000000UL)
+#define CYCLES_PER_MS (F_CPU / 1000UL)
+
+void cycleCounterBegin();
+uint32_t cycleCount();
+
+inline uint16_t cycleCount16() {
+  return TCNT5;
+}
+
+#endif
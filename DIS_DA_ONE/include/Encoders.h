@@ -0,0 +1,63 @@
+/*
+  Encoders.h
+  Kyzer Bowen, Tyce Miller
+
+  Wheel encoder capture and speed estimation. The encoder ISRs count ticks and also record a micros() time stamp
+  for every tick in a small ring buffer per wheel. update() drains the buffers in the foreground and works out the
+  wheel speed from the time between ticks, so the speed is fresh after every tick instead of once per 100 ms window
+  (at 40 ticks/rev a 100 ms window only sees a handful of ticks).
+  Each ring has one writer (the ISR, it only moves head) and one reader (update(), it only moves tail), so neither
+  side has to turn interrupts off.
+  The tick counts are 32 bit and never reset. A long takes four loads on the AVR, so an encoder interrupt in the
+  middle of a read would tear it. The counts are only read with interrupts off, and every user keeps its own
+  EncoderSnapshot and asks for the ticks since then instead of clearing a shared counter.
+
+  The primary functions created are
+  begin - attach the encoder interrupts (pins 18 and 19)
+  update - drain the time stamps and refresh lastSpeed, the encoder task in main.cpp runs it every scheduler pass
+  total - running tick count for one wheel since begin()
+  snapshot - tick counts of both wheels read at the same instant
+  delta - ticks each wheel has made since a snapshot, moves the snapshot up to now
+  overflows - number of ticks whose time stamp was dropped because update() did not keep up
+
+  Key variables
+  EncoderSnapshot - tick counts of both wheels and the micros() they were read at, one per user of the counts
+  lastSpeed - wheel speed in cm/s (Q16.16), sign follows the step engine direction
+  ENCODER_RING_SIZE - time stamps each wheel can hold between update() calls (power of 2)
+  ENCODER_TIMEOUT_US - no tick for this long means the wheel has stopped
+*/
+
+#ifndef ENCODERS_H
+#define ENCODERS_H
+
+#include <Arduino.h>
+#include "FixedKinematics.h"
+
+#define ENCODER_RING_SIZE 16          //time stamps per wheel, must be a power of 2
+#define ENCODER_TIMEOUT_US 300000UL   //no tick for 300 ms reads as 0 cm/s
+
+//tick counts of both wheels at one instant, indexed by LEFT and RIGHT
+struct EncoderSnapshot {
+  long ticks[2];          //running tick counts
+  unsigned long time;     //micros() when the counts were read
+};
+
+class WheelEncoders {
+public:
+  void begin();
+  void update();
+  long total(uint8_t wheel);
+  void snapshot(EncoderSnapshot &snap);
+  void delta(EncoderSnapshot &since, long ticks[2]);
+  unsigned int overflows(uint8_t wheel);
+
+  fix16 lastSpeed[2];   //wheel speed in cm/s (Q16.16), indexed by LEFT and RIGHT
+
+private:
+  unsigned long lastStamp[2][3];   //newest three tick times for each wheel, [0] is the newest
+  uint8_t stamps[2];               //number of valid entries in lastStamp (0 to 3)
+};
+
+extern WheelEncoders encoders;   //the one pair of wheel encoders
+
+#endif
@@ -0,0 +1,86 @@
+/*
+  FixedKinematics.h
+  Kyzer Bowen, Tyce Miller
+
+  Q16.16 fixed point kinematics for the motion functions. The ATmega2560 has no FPU, so converting distances and
+  angles to wheel steps with float math costs hundreds of cycles per operation. Here the conversion factors are
+  worked out at compile time and the motion functions only do integer multiplies and shifts.
+  goToGoal() gets its heading and distance from a CORDIC, no atan2() or sqrt() needed.
+
+  The primary functions created are
+  fixMul - multiply two Q16.16 numbers
+  fixMulToInt - multiply two Q16.16 numbers and round the result to a whole number (no 32767 limit on the result)
+  fixPolar - heading in degrees and length of an x, y vector in one CORDIC pass
+  fixSinCos - sine and cosine of an angle in degrees in one CORDIC pass
+  fixWrapDegrees - bring an angle back into -180 to 180 degrees
+  stepsForDistance, ticksForDistance - wheel steps and encoder ticks for a straight move in cm
+  stepsForSpin, ticksForSpin - wheel steps and encoder ticks for a spin in place in degrees
+  stepsForCircle - wheel steps for one lap of a circle with the given diameter in cm
+  setDriveGeometry - rebuild drive for a measured wheel circumference, track width and encoder ticks per rotation
+
+  Key variables
+  fix16 - Q16.16 number, 16 bits whole part and 16 bits fraction
+  drive - conversion factors for the robot, built from RobotConfig.h at compile time, replaced at boot by the
+          calibration stored in EEPROM (Calibration.h)
+*/
+
+#ifndef FIXED_KINEMATICS_H
+#define FIXED_KINEMATICS_H
+
+#include <Arduino.h>
+
+typedef int32_t fix16;    //Q16.16 fixed point number
+#define FIX_ONE 65536L    //1.0 in Q16.16
+
+//function to build a Q16.16 constant at compile time, rounds to the nearest 1/65536
+constexpr fix16 toFix(double value) {
+  return (fix16)(value * 65536.0 + (value >= 0 ? 0.5 : -0.5));
+}
+
+//function to turn a whole number into Q16.16
+inline fix16 fixFromInt(long value) {
+  return (fix16)(value * FIX_ONE);
+}
+
+//function to round a Q16.16 number to the nearest whole number
+inline long fixRound(fix16 value) {
+  return value >= 0 ? (value + 0x8000L) >> 16 : -((-value + 0x8000L) >> 16);
+}
+
+//function to drop the fraction of a Q16.16 number (rounds toward zero like a float to int cast)
+inline long fixTrunc(fix16 value) {
+  return value >= 0 ? value >> 16 : -((-value) >> 16);
+}
+
+fix16 fixMul(fix16 a, fix16 b);
+long fixMulToInt(fix16 a, fix16 b);
+void fixPolar(fix16 x, fix16 y, fix16 *angle, fix16 *length);
+void fixSinCos(fix16 degrees, fix16 *sine, fix16 *cosine);
+fix16 fixWrapDegrees(fix16 degrees);
+
+//conversion factors between distances, angles, wheel steps and encoder ticks
+struct DriveGeometry {
+  fix16 stepsPerCm;         //wheel steps for 1 cm of travel, steps per rotation / wheel circumference
+  fix16 ticksPerCm;         //encoder ticks for 1 cm of travel, ticks per rotation / wheel circumference
+  fix16 cmPerTick;          //cm of travel for 1 encoder tick, turns encoder tick rates into wheel speeds
+  fix16 stepsPerDegree;     //wheel steps for 1 degree of spin in place
+  fix16 ticksPerDegree;     //encoder ticks for 1 degree of spin in place
+  fix16 degreesPerTick;     //degrees of spin in place for 1 encoder tick on each wheel (opposite directions)
+  fix16 stepsPerCmCircle;   //wheel steps per cm of circle diameter (PI cancels: steps per rotation / wheel diameter)
+  fix16 trackWidth;         //distance between the wheels in cm
+};
+
+extern DriveGeometry drive;   //conversion factors for this robot
+
+long stepsForDistance(fix16 cm);
+fix16 ticksForDistance(fix16 cm);
+long stepsForSpin(fix16 degrees);
+fix16 ticksForSpin(fix16 degrees);
+long stepsForCircle(fix16 diameter);
+void setDriveGeometry(float circumference, float trackWidth, float ticksPerRotation);
+
+#ifdef KINEMATICS_BENCHMARK
+void benchmark_kinematics();
+#endif
+
+#endif
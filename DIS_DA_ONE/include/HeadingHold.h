@@ -0,0 +1,87 @@
+/*
+  HeadingHold.h
+  Kyzer Bowen, Tyce Miller
+
+  Gyro heading control for motion segments flagged SEG_HEADING: straight segments hold their heading (forward and
+  reverse when the IMU is up), spins in place stop on their angle (spin and goToAngle).
+
+  Straight segments
+  The encoders sit on the wheels, so a wheel that slips still counts its ticks and SEG_CORRECT can not see the
+  heading it costs. Here every HEADING_PERIOD_US the heading the gyro has integrated (Odometry.h gyroHeading) is
+  compared with the heading at the start of the segment, and a PI controller speeds one wheel up and slows the
+  other down by the same amount so the robot steers back while the path speed stays the same.
+  The step difference the trim has made is kept: both wheels get the same steps still to go on top of what each
+  has made, so the correction is not undone when the faster wheel reaches its target first.
+
+  differential = kp * heading error + ki * integral of the heading error (steps/s, right wheel minus left wheel forward)
+  right speed = speed + differential / 2, left speed = speed - differential / 2 (the other way round in reverse)
+
+  Spins
+  The steps of the segment only set off the spin. Every period the angle still to go is the segment angle less
+  what the gyro has turned since the start, and both wheel targets are set that many steps (drive.stepsPerDegree)
+  from where the wheels are. The step engine's ramp decelerates onto the target, so the spin ends on the gyro angle
+  in one motion and the wheel and track sizes only matter for the speed. Once the wheels stop the gyro gets
+  HEADING_SETTLE periods to catch up, a spin that is still more than HEADING_TOLERANCE off goes on from there.
+
+  The primary functions created are
+  begin - load the default gains, called by motionQueue.begin()
+  setGains - PI gains, steps/s of wheel speed difference per degree of heading error
+  start - take the heading to hold from the gyro, called by the motion queue when the segment starts
+  update - run one period, the heading task in main.cpp calls it every HEADING_PERIOD_US
+  stop - stop steering (queue cleared or segment finished)
+  settled - true once a spin has stopped on its angle (straight segments are done when their steps are)
+  error - last heading error in degrees
+
+  Key variables
+  HEADING_PERIOD_US - control period, 20000 us = 50 Hz (the odometry rate the gyro heading comes at)
+  HEADING_MAX_TRIM - largest speed change of each wheel in percent of the segment speed
+  HEADING_MAX_EXTRA - largest spin past its planned steps in percent, keeps a dead gyro from spinning for ever
+*/
+
+#ifndef HEADING_HOLD_H
+#define HEADING_HOLD_H
+
+#include <Arduino.h>
+#include "FixedKinematics.h"
+#include "MotionQueue.h"
+
+#define HEADING_PERIOD_US 20000UL   //50 Hz
+#define HEADING_MAX_TRIM 20         //percent of the segment speed
+#define HEADING_MAX_EXTRA 25        //percent of the planned spin steps
+#define HEADING_TOLERANCE toFix(0.5) //degrees a spin may end off its angle
+#define HEADING_SETTLE 3            //periods the wheels stand still before a spin is done
+#define HEADING_LEAD toFix(0.02)    //s the gyro heading runs behind the robot (one odometry period and the low pass)
+
+class HeadingHold {
+public:
+  void begin();
+  void setGains(fix16 kp, fix16 ki);
+  void start(const MotionSegment &segment);
+  void update();
+  void stop();
+  bool settled();
+  fix16 error() { return err; }
+
+private:
+  void holdStraight();
+  void holdSpin();
+
+  fix16 kp, ki;              //steps/s per degree and per degree*s
+  bool active;               //a segment is being steered
+  long startPos[2];          //step position when the segment started
+  bool spinning;             //the wheels turn opposite ways, the segment is a spin
+  long planned;              //steps each wheel should make, both the same
+  int8_t dir;                //straight: 1 forward, -1 reverse
+  float speed;               //segment speed in steps/s before trimming
+  fix16 target;              //straight: gyro heading to hold, spin: degrees to turn counterclockwise
+  fix16 turned;              //spin: degrees the gyro has turned since the start, not wrapped
+  fix16 last;                //spin: gyro heading at the last period
+  uint8_t still;             //spin: periods the wheels have stood still on the angle
+  fix16 err;                 //heading error from the last period, degrees
+  fix16 integral;            //integral of the error in degree*s
+  long offset;               //half the step difference the trim has made, right wheel ahead positive
+};
+
+extern HeadingHold headingHold;   //the one heading controller, started by the motion queue, run by the heading task
+
+#endif
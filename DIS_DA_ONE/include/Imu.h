@@ -0,0 +1,68 @@
+/*
+  Imu.h
+  Kyzer Bowen, Tyce Miller
+
+  MPU6050 driver built on the interrupt driven TWI in Twi.h. The MPU6050 samples on its own clock and stacks the
+  samples in its FIFO, its INT pin (digital pin 2) pulses when a new sample is ready. That interrupt starts a
+  FIFO count read, and when the count is in the TWI interrupt reads the waiting samples in one burst at 400 kHz
+  and drops them into a ring buffer. Foreground code pops samples with read(), nothing ever waits on the bus.
+  MPU6050 register map: https://invensense.tdk.com/wp-content/uploads/2015/02/MPU-6000-Register-Map1.pdf
+
+  The primary functions created are
+  begin - check the chip is there, set the ranges, sample rate and FIFO, and attach the INT interrupt
+  reset, configure - the two halves of begin(), for callers that do other work during the IMU_RESET_MS between them
+  calibrate - average the gyro while the robot sits still and use it as the zero rate
+  calibrateStart, calibratePoll - the same without waiting, poll until it returns true
+  read - pop the oldest sample (gyro zero removed), false when there is none
+  latest - copy of the newest sample without popping it
+  overflows - samples lost because the ring or the MPU6050 FIFO filled up
+
+  Key variables
+  ImuSample - one raw sample, accel in IMU_ACCEL_LSB per g, gyro in IMU_GYRO_LSB per degree/s
+  IMU_SAMPLE_HZ - MPU6050 sample rate
+  IMU_RING_SIZE - samples held for the foreground (power of 2)
+*/
+
+#ifndef IMU_H
+#define IMU_H
+
+#include <Arduino.h>
+
+#define MPU_ADDRESS 0x68      //AD0 low
+#define IMU_SAMPLE_HZ 200     //samples per second out of the FIFO
+#define IMU_RING_SIZE 16      //samples, must be a power of 2
+#define IMU_BURST 4           //most samples read from the FIFO in one transfer
+#define IMU_GYRO_LSB 65.5     //gyro counts per degree/s at +-500 degrees/s
+#define IMU_ACCEL_LSB 4096.0  //accel counts per g at +-8 g
+#define IMU_GRAVITY 9.80665   //m/s^2 per g
+#define IMU_RESET_MS 100      //time the MPU6050 takes to come out of reset
+
+//one sample in FIFO order
+struct ImuSample {
+  int16_t accel[3];       //x, y, z
+  int16_t temperature;    //degrees C = temperature / 340 + 36.53
+  int16_t gyro[3];        //x, y, z
+};
+
+class MpuImu {
+public:
+  bool begin();
+  bool reset();
+  bool configure();
+  bool calibrate(uint16_t samples);
+  void calibrateStart();
+  bool calibratePoll(uint16_t samples);
+  bool read(ImuSample &sample);
+  bool latest(ImuSample &sample);
+  unsigned int overflows();
+
+  int16_t gyroBias[3];    //gyro counts at rest, taken off every sample by read()
+
+private:
+  long biasSum[3];        //gyro counts added up by calibratePoll()
+  uint16_t biasCount;     //samples in biasSum
+};
+
+extern MpuImu imu;   //the one MPU6050
+
+#endif
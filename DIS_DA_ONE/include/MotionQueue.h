@@ -0,0 +1,101 @@
+/*
+  MotionQueue.h
+  Kyzer Bowen, Tyce Miller
+
+  Fixed size queue of motion segments for the step engine. The motion functions (forward, spin, turn, moveCircle ...)
+  push segments here and return right away, and service() starts the next segment whenever the wheels have stopped,
+  so loop() keeps running the serial/Bluetooth link and sensors while the robot moves.
+
+  Look ahead: when a segment and the one after it turn both wheels the same way (the circles of a figure 8, a row
+  of turns) the wheels do not stop between them. Like the planner in CNC firmware, each wheel gets a junction speed
+  no higher than either segment's speed and low enough that every segment still queued behind can stop in time
+  (a backward pass over the queue, in the steps the step engine's S-curve needs to stop from each speed). The next segment is chained into
+  the step engine while the current one runs and the ISR goes straight from one to the other.
+  Two SEG_LINKED segments always blend, the junction is planned for the path (the faster wheel) and kept low enough
+  that neither wheel's speed jumps by more than MOTION_MAX_JUMP where the curvature changes (figure 8 crossover).
+  Other segments with flags or a dwell always stop, the wheel controller and path follower work on one segment at a time.
+
+  The primary functions created are
+  begin - set up an empty queue, the wheel controller (WheelControl.h) and the heading hold (HeadingHold.h)
+  push - add a segment to the end of the queue, returns its segment number (0 when the queue is full)
+  service - start segments and end them once the controllers are done, the motion task in main.cpp runs it every
+    scheduler pass (the controllers run as tasks of their own)
+  clear - drop everything that is queued and bring the wheels to a stop
+  busy, segmentIndex, isDone, remainingSteps - status polled from loop()
+
+  Key variables
+  MOTION_QUEUE_SIZE - number of segments that can be waiting at once
+  MOTION_ACCELERATION - wheel acceleration in steps/s^2 the planner works with, set on the step engine by begin()
+  MOTION_JERK - how fast the acceleration itself may change in steps/s^3, the S-curve ramps of every segment
+  SEG_CORRECT - segment flag, the wheel controller steers the segment by the encoders until they count the expected ticks
+  SEG_GOAL - segment flag, the path follower drives to a point in field coordinates from the odometry pose
+  SEG_LINKED - segment flag, the step engine runs the wheels as one move, the faster wheel's speed sets the pace
+  SEG_HEADING - segment flag, the heading hold steers a straight segment by the gyro or stops a spin on its gyro
+                angle, SEG_CORRECT is used instead when the odometry has no gyro
+  MOTION_MAX_JUMP - largest instant change of a wheel speed allowed where two linked segments of different curvature meet
+*/
+
+#ifndef MOTION_QUEUE_H
+#define MOTION_QUEUE_H
+
+#include <Arduino.h>
+#include "FixedKinematics.h"
+
+#define MOTION_QUEUE_SIZE 16   //segments that can be waiting at once
+#define MOTION_ACCELERATION 10000.0   //steps/s^2
+#define MOTION_JERK 100000.0          //steps/s^3, full acceleration after 0.1 s
+#define MOTION_MAX_JUMP 200.0         //steps/s
+
+#define SEG_CORRECT 0x01       //close the loop on the encoders during the segment (WheelControl.h)
+#define SEG_GOAL 0x02          //drive one arc to goal instead of making steps (PathFollower.h)
+#define SEG_LINKED 0x04        //both wheels as one coordinated move, the step ratio holds during the ramps (StepEngine.h)
+#define SEG_HEADING 0x08       //hold the gyro heading, or end a spin on the gyro angle (HeadingHold.h)
+
+//one move of both wheels, steps and speeds are indexed by RIGHT and LEFT
+struct MotionSegment {
+  long steps[2];          //relative steps for each wheel
+  float speed[2];         //max speed for each wheel in steps/s
+  fix16 ticks;            //encoder ticks each wheel should count during the segment in Q16.16 (SEG_CORRECT only)
+  fix16 goal[2];          //field x, y in cm to drive to in Q16.16 (SEG_GOAL only, steps are not used)
+  fix16 angle;            //degrees a spin turns in Q16.16, counterclockwise positive (SEG_HEADING spins only)
+  unsigned int dwell;     //pause in ms after the segment before the next one starts
+  uint8_t flags;          //SEG_ flags
+  unsigned int id;        //segment number handed out by push()
+};
+
+class MotionQueue {
+public:
+  void begin();
+  unsigned int push(const MotionSegment &segment);
+  void service();
+  void clear();
+
+  bool busy();
+  unsigned int segmentIndex();
+  bool isDone(unsigned int id);
+  long remainingSteps();
+  uint8_t freeSlots();
+
+private:
+  void start(const MotionSegment &segment);
+  bool blends(const MotionSegment &from, const MotionSegment &to);
+  float junctionLimit(const MotionSegment &before, const MotionSegment &after, uint8_t wheel);
+  float junctionSpeed(uint8_t wheel);
+  void chainNext();
+  void finished(unsigned int id);
+
+  MotionSegment queue[MOTION_QUEUE_SIZE];   //ring buffer of waiting segments
+  uint8_t head;                             //index of the next segment to run
+  uint8_t count;                            //number of waiting segments
+  MotionSegment current;                    //segment being run
+  bool active;                              //true from the start of a segment until its dwell is over
+  bool moving;                              //true until the wheels stop at the end of the segment
+  bool chainedNext;                         //the first queued segment is chained behind the current one
+  unsigned long dwellStart;                 //millis() when the wheels stopped
+  unsigned int nextId;                      //segment number for the next push()
+  unsigned int doneId;                      //last segment number that has completely finished
+};
+
+extern MotionQueue motionQueue;   //the one motion queue, fed by the motion functions in main.cpp
+
+#endif
@@ -0,0 +1,76 @@
+/*
+  Odometry.h
+  Kyzer Bowen, Tyce Miller
+
+  Keeps track of where the robot is (x, y in cm and heading in degrees) from the moment the robot starts, so the
+  motion functions can work in field coordinates instead of zeroing everything before each move.
+  Every ODOMETRY_PERIOD_US the encoder ticks since the last update move the pose along the current heading.
+  With the IMU up the heading is the integrated gyro rate, the gyro does not see wheel slip. The encoders never pull
+  the heading toward their own: a slipping wheel leaves the encoder heading wrong for good, and pulling toward it
+  would bring that error into the pose. Gyro drift is taken out at the rate instead. While the wheels have stood
+  still for GYRO_STILL_PERIODS the true yaw rate is 0, so what the gyro reads then is its bias and is slowly learned.
+  Without the IMU the heading comes from the encoder ticks.
+  https://en.wikipedia.org/wiki/Dead_reckoning
+
+  x axis points straight ahead of the robot at startup, y axis to its left, heading is counterclockwise positive.
+
+  The primary functions created are
+  begin - start at (0, 0) facing 0 degrees
+  setGyro - give the filter a function that reads the yaw rate in degrees/s, without one only the encoders are used
+  reset - move the pose to a known position
+  update - run one odometry period, the odometry task in main.cpp calls it every ODOMETRY_PERIOD_US
+  pose - current position and heading
+  hasGyro, gyroHeading, gyroYawRate - the gyro is in use, the heading from the gyro alone (HeadingHold.h holds it)
+                                      and the last yaw rate, both with the bias taken out
+
+  Key variables
+  Pose - x, y in cm and heading in degrees (-180 to 180), all Q16.16
+  ODOMETRY_PERIOD_US - odometry period, 20000 us = 50 Hz
+  GYRO_STILL_PERIODS - periods with no step and no tick before the gyro reading counts as bias (the robot has settled)
+  GYRO_BIAS_WEIGHT - share of the gap between the still reading and the bias learned each still period
+*/
+
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <Arduino.h>
+#include "FixedKinematics.h"
+#include "Encoders.h"
+
+#define ODOMETRY_PERIOD_US 20000UL   //50 Hz
+#define GYRO_STILL_PERIODS 10        //200 ms standing still before the bias is learned
+#define GYRO_BIAS_WEIGHT toFix(0.02) //about 1 s of standing still to learn a new bias
+
+//position and heading of the robot
+struct Pose {
+  fix16 x;          //cm
+  fix16 y;          //cm
+  fix16 heading;    //degrees, counterclockwise positive, -180 to 180
+};
+
+class Odometry {
+public:
+  void begin();
+  void setGyro(bool (*readRate)(fix16 *degreesPerSec));
+  void reset(fix16 x, fix16 y, fix16 heading);
+  void update();
+  Pose pose();
+  bool hasGyro() { return readGyro != 0; }
+  fix16 gyroHeading() { return gyroAngle; }
+  fix16 gyroYawRate() { return gyroRate; }
+
+private:
+  Pose current;                                //fused pose
+  EncoderSnapshot mark;                        //encoder counts at the last update
+  unsigned long lastRun;                       //micros() of the last update
+  bool (*readGyro)(fix16 *degreesPerSec);      //yaw rate source, 0 when there is no gyro
+  fix16 gyroRaw;                               //last gyro reading in degrees/s, used again if no sample came in
+  fix16 gyroBias;                              //degrees/s the gyro reads standing still, learned from the still periods
+  fix16 gyroRate;                              //gyroRaw less the bias
+  fix16 gyroAngle;                             //gyroRate integrated, the heading before reset() moves it
+  uint8_t still;                               //periods the wheels have stood still, up to GYRO_STILL_PERIODS
+};
+
+extern Odometry odometry;   //the one pose estimate
+
+#endif
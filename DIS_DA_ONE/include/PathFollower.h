@@ -0,0 +1,67 @@
+/*
+  PathFollower.h
+  Kyzer Bowen, Tyce Miller
+
+  Pure pursuit goal follower for motion segments flagged SEG_GOAL. Instead of spinning to face the goal, stopping
+  and driving straight, the robot drives one smooth arc to the goal. Every PURSUIT_PERIOD_US the follower takes the
+  pose from the odometry (Odometry.h) and works out the arc that starts along the robot's heading and passes through
+  the goal, then sets the two wheel speeds for that arc. Being recomputed from the pose every period the arc
+  absorbs slip and drift on the way.
+  The forward speed slows down in proportion to the distance left, and a goal that is more than PURSUIT_SPIN_ANGLE
+  off the heading (for example behind the robot) is turned toward in place first, since the arc there would be huge.
+  R. Craig Coulter, "Implementation of the Pure Pursuit Path Tracking Algorithm", CMU-RI-TR-92-01
+
+  arc curvature = 2 sin(angle to goal) / distance to goal
+  right wheel = v (1 + curvature * track / 2), left wheel = v (1 - curvature * track / 2)
+
+  The primary functions created are
+  begin - load the default tolerance, called by motionQueue.begin()
+  setTolerance - how close to the goal counts as there
+  start - begin driving to the goal of a segment, called by the motion queue when the segment starts
+  update - run one pursuit period, the pursuit task in main.cpp calls it every PURSUIT_PERIOD_US
+  stop - give up on the goal and stop the wheels
+  active - true until the robot is within the tolerance of the goal
+
+  Key variables
+  PURSUIT_PERIOD_US - pursuit period, 20000 us = 50 Hz (the odometry rate)
+  PURSUIT_TOLERANCE - default distance from the goal that ends the segment
+  PURSUIT_SLOWDOWN - forward speed in steps/s per step still to go, sets how early the robot slows down
+  PURSUIT_ACCEL - largest change of a wheel speed in steps/s^2
+*/
+
+#ifndef PATH_FOLLOWER_H
+#define PATH_FOLLOWER_H
+
+#include <Arduino.h>
+#include "FixedKinematics.h"
+#include "MotionQueue.h"
+
+#define PURSUIT_PERIOD_US 20000UL         //50 Hz
+#define PURSUIT_TOLERANCE toFix(1.0)      //cm
+#define PURSUIT_SPIN_ANGLE toFix(60)      //degrees off the heading that are turned in place first
+#define PURSUIT_SLOWDOWN toFix(2.0)       //1/s, the robot is at full speed until the time left is about 0.5 s
+#define PURSUIT_MIN_SPEED toFix(40)       //steps/s, slowest forward speed so the last cm does not take forever
+#define PURSUIT_ACCEL 1500                //steps/s^2
+
+class PathFollower {
+public:
+  void begin();
+  void setTolerance(fix16 cm);
+  void start(const MotionSegment &segment);
+  void update();
+  void stop();
+  bool active();
+
+private:
+  void setWheels(fix16 right, fix16 left);
+
+  bool running;                  //driving to a goal
+  fix16 goal[2];                 //field x, y in cm
+  fix16 cruise;                  //top forward speed in steps/s
+  fix16 tolerance;               //cm
+  fix16 wheelSpeed[2];           //speed set on each wheel last period in steps/s, indexed by RIGHT and LEFT
+};
+
+extern PathFollower pathFollower;   //the one goal follower, started by the motion queue, run by the pursuit task
+
+#endif
@@ -0,0 +1,118 @@
+/*
+  Probes.h
+  Kyzer Bowen, Tyce Miller
+
+  Timing probes on the hot paths, to find where the time goes on the robot without rebuilding with print statements.
+  A probe is one line at the top of a function or ISR:
+    PROBE(PROBE_FORWARD);
+  It reads the cycle counter (CycleCounter.h) there and again when the function returns, and adds the time to the
+  probe's count, min, max and total in probeTable. The "probes;" command prints the table on the port it came from
+  and starts it over, so each query shows the time since the last one.
+  A probe costs about 2 us in the foreground and under 1 us in an ISR (PROBE_ISR reads only the low 16 bits).
+  Probes nest, an outer probe includes the time of the ones inside it (the command probes include the motion
+  function the command ran). Build with -D TIMING_PROBES=0 and every probe and the table compile out.
+
+  The primary functions created are
+  probesBegin - start the cycle counter
+  probesPrint - print the table and clear it
+  PROBE, PROBE_ISR - time the rest of the enclosing block
+
+  Key variables
+  ProbeId - one entry of probeTable per probed function
+  ProbeStat - count, min, max and total of one probe in CPU cycles, the total wraps after 268 s of time in one probe
+*/
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <Arduino.h>
+
+#ifndef TIMING_PROBES
+#define TIMING_PROBES 1   //build with -D TIMING_PROBES=0 to take every probe out
+#endif
+
+enum ProbeId {
+  PROBE_FORWARD,          //forward()
+  PROBE_REVERSE,          //reverse()
+  PROBE_SPIN,             //spin()
+  PROBE_TURN,             //turn()
+  PROBE_PIVOT,            //pivot()
+  PROBE_CIRCLE,           //moveCircle()
+  PROBE_GOAL,             //goToGoal()
+  PROBE_RUN_TO_STOP,      //runToStop()
+  PROBE_QUEUE,            //motionQueue.service()
+  PROBE_ODOMETRY,         //odometry.update()
+  PROBE_ENCODER_RIGHT,    //right encoder ISR
+  PROBE_ENCODER_LEFT,     //left encoder ISR
+  PROBE_SERIAL,           //serial monitor commands
+  PROBE_BLUETOOTH,        //Bluetooth commands
+  PROBE_TELEMETRY,        //telemetry.update()
+  PROBE_COUNT
+};
+
+#if TIMING_PROBES
+
+#include "CycleCounter.h"
+
+struct ProbeStat {
+  uint32_t count;   //calls
+  uint32_t total;   //cycles
+  uint32_t min;     //cycles
+  uint32_t max;     //cycles
+};
+
+extern ProbeStat probeTable[PROBE_COUNT];
+
+//function to add one call to a probe, ISR probes only run with interrupts off so the two sides never share an entry
+inline void probeRecord(ProbeStat &stat, uint32_t cycles) {
+  if (stat.count == 0 || cycles < stat.min) {
+    stat.min = cycles;
+  }
+  if (cycles > stat.max) {
+    stat.max = cycles;
+  }
+  stat.total += cycles;
+  stat.count++;
+}
+
+//foreground probe, times from construction to the end of the block
+class ProbeScope {
+public:
+  ProbeScope(ProbeStat &stat) : stat(stat), start(cycleCount()) {}
+  ~ProbeScope() { probeRecord(stat, cycleCount() - start); }
+
+private:
+  ProbeStat &stat;
+  uint32_t start;
+};
+
+//ISR probe, 16 bits of the counter are plenty for an ISR and take one register read
+class ProbeIsrScope {
+public:
+  ProbeIsrScope(ProbeStat &stat) : stat(stat), start(cycleCount16()) {}
+  ~ProbeIsrScope() { probeRecord(stat, (uint16_t)(cycleCount16() - start)); }
+
+private:
+  ProbeStat &stat;
+  uint16_t start;
+};
+
+void probesBegin();
+void probesPrint(Print &port);
+
+#define PROBE(id) ProbeScope probeScope(probeTable[id])
+#define PROBE_ISR(id) ProbeIsrScope probeScope(probeTable[id])
+
+#else
+
+#define PROBE(id)
+#define PROBE_ISR(id)
+
+inline void probesBegin() {}
+inline void probesPrint(Print &port) {
+  port.println("probes are compiled out (TIMING_PROBES=0)");
+}
+
+#endif
+
+#endif
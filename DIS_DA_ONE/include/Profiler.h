@@ -0,0 +1,97 @@
+/*
+  Profiler.h
+  Kyzer Bowen, Tyce Miller
+
+  On target timing of the interrupt and loop hot paths, the baseline for every performance change to the firmware.
+  Only built with -D PROFILE_BENCHMARK (pio run -e profile_benchmark), the PROFILE_ macros are empty otherwise.
+  Times are CPU cycles from the Timer5 cycle counter (CycleCounter.h).
+
+  What is measured
+  step ISRs - latency from the Timer1 compare match to the first line of the ISR (TCNT1 - OCR1x, which includes the
+              interrupt response and the ISR prologue), and duration. Compare A is the right wheel or a linked move.
+  encoder ISRs - duration of the handler, the dispatch in attachInterrupt() before it is not included
+  loop() - time of every pass, in a histogram of power of 2 buckets, runToStop() and the other blocking moves show
+           up as the long passes
+  step rate - at startup both wheels are run at rising speeds with the drivers turned off, the highest rate each
+              wheel really makes with no late step is its sustained rate
+
+  The startup sweep is printed once, the ISR and loop numbers every PROFILE_REPORT_MS, then they start over.
+
+  The primary functions created are
+  profileBegin - start the cycle counter and the statistics
+  profileLoop - time one pass through loop() and print the report when it is due, call it first thing in loop()
+  benchmark_step_rate - startup step rate sweep
+
+  Key variables
+  ProfileStat - count, min, max and total of one measurement in CPU cycles
+  PROFILE_LOOP_BUCKETS - loop() histogram buckets, bucket 0 is under 256 cycles (16 us) and each one after is twice as wide
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifdef PROFILE_BENCHMARK
+
+#include <Arduino.h>
+#include "CycleCounter.h"
+
+#define PROFILE_REPORT_MS 10000UL   //time between reports
+#define PROFILE_LOOP_BUCKETS 16     //the last bucket holds every pass of 256 << 14 cycles (262 ms) or more
+#define PROFILE_RATE_STEP 1000      //steps/s between the rates of the startup sweep
+#define PROFILE_RATE_MAX 20000      //last rate of the sweep, STEP_MIN_INTERVAL does not allow more
+#define PROFILE_WINDOW_MS 250       //time each rate is measured over
+
+//measurements, ISR durations and step latencies are kept apart
+enum ProfileSlot {
+  PROFILE_STEP_RIGHT,
+  PROFILE_STEP_LEFT,
+  PROFILE_ENCODER_RIGHT,
+  PROFILE_ENCODER_LEFT,
+  PROFILE_SLOTS
+};
+
+struct ProfileStat {
+  uint32_t count;   //measurements
+  uint32_t total;   //cycles, all of them added up
+  uint16_t min;     //cycles
+  uint16_t max;     //cycles
+};
+
+extern ProfileStat profileIsrTime[PROFILE_SLOTS];
+extern ProfileStat profileLatency[2];          //step ISRs only, indexed by PROFILE_STEP_RIGHT and PROFILE_STEP_LEFT
+extern volatile uint16_t profileLate[2];       //steps scheduled late (the ISR missed its own interval)
+
+//function to add one measurement, runs inside ISRs so it is kept short
+inline void profileRecord(ProfileStat &stat, uint16_t cycles) {
+  if (stat.count == 0 || cycles < stat.min) {
+    stat.min = cycles;
+  }
+  if (cycles > stat.max) {
+    stat.max = cycles;
+  }
+  stat.total += cycles;
+  stat.count++;
+}
+
+void profileBegin();
+void profileClear();
+void profileLoop();
+void benchmark_step_rate();
+
+#define PROFILE_ISR_BEGIN() uint16_t profileStart = cycleCount16()
+#define PROFILE_ISR_END(slot) profileRecord(profileIsrTime[slot], cycleCount16() - profileStart)
+#define PROFILE_STEP_LATENCY(slot, ocr) profileRecord(profileLatency[slot], (uint16_t)(TCNT1 - (ocr)) * 8)
+#define PROFILE_STEP_LATE(slot) profileLate[slot]++
+#define PROFILE_LOOP() profileLoop()
+
+#else
+
+#define PROFILE_ISR_BEGIN()
+#define PROFILE_ISR_END(slot)
+#define PROFILE_STEP_LATENCY(slot, ocr)
+#define PROFILE_STEP_LATE(slot)
+#define PROFILE_LOOP()
+
+#endif
+
+#endif
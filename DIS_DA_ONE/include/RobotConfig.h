@@ -0,0 +1,56 @@
+/*
+  RobotConfig.h
+  Kyzer Bowen, Tyce Miller
+
+  Shared hardware definitions for the robot so every source file agrees on pin numbers and wheel indices.
+
+  Hardware Connections:
+  Arduino pin mappings: https://www.arduino.cc/en/Hacking/PinMapping2560
+  digital pin 48 - enable PIN on A4988 Stepper Motor Driver StepSTICK
+  digital pin 50 - right stepper motor step pin
+  digital pin 51 - right stepper motor direction pin
+  digital pin 52 - left stepper motor step pin
+  digital pin 53 - left stepper motor direction pin
+  digital pin 18 - left encoder pin
+  digital pin 19 - right encoder pin
+  digital pin 2 - IMU INT
+  digital pin 20 - IMU SDA
+  digital pin 21 - IMU SCL
+*/
+
+#ifndef ROBOT_CONFIG_H
+#define ROBOT_CONFIG_H
+
+#include <Arduino.h>
+
+//define motor pin numbers
+#define stepperEnable 48    //stepper enable pin on stepStick 
+#define rtStepPin 50 //right stepper motor step pin 
+#define rtDirPin 51  // right stepper motor direction pin 
+#define ltStepPin 52 //left stepper motor step pin 
+#define ltDirPin 53  //left stepper motor direction pin 
+
+#define stepperEnTrue false //variable for enabling stepper motor
+#define stepperEnFalse true //variable for disabling stepper motor
+
+//define encoder pins (Mega Interrupt pins 2,3 18,19,20,21)
+#define ltEncoder 18  //left encoder pin
+#define rtEncoder 19  //right encoder pin
+
+#define imuIntPin 2   //MPU6050 data ready interrupt (INT4)
+
+//wheel indices shared by the encoder arrays and the step engine
+#define LEFT 1        //left wheel
+#define RIGHT 0       //right wheel
+
+//drive train constants
+#define stepsPerRev 800   //stepper steps for one wheel rotation (quarter stepping)
+#define ticksPerRev 40    //encoder ticks for one wheel rotation (CHANGE interrupt on both edges)
+
+//define robot measurements
+constexpr float wheelDiam = 8.6;    // Wheel diameter on robot (cm)
+constexpr float wheelCirc = wheelDiam*PI;    // Wheel circumfrence on robot (cm)
+constexpr float robotDiam = 21;   // Robot Diameter from center to center of the wheels (cm)
+constexpr float spinDegPerTick = wheelCirc / ticksPerRev / (PI * robotDiam) * 360;  // degrees of spin per encoder pulse (3.69), each wheel rolls along the spin circle
+
+#endif
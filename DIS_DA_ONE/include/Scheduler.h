@@ -0,0 +1,67 @@
+/*
+  Scheduler.h
+  Kyzer Bowen, Tyce Miller
+
+  Small cooperative scheduler that loop() runs instead of calling each subsystem itself. The tasks are a fixed table
+  in main.cpp (like the command table), each entry a function and the period it should run at, 0 for every pass.
+  run() goes down the table once and calls every task that is due, in table order, so a task that needs fresh data
+  from another one comes after it. Nothing is preempted: a task runs to its end and the Timer1 step and encoder
+  interrupts are what keep time while it does.
+
+  A task is due every period from when it last was due, not from when it last ran, so its rate does not drift with
+  the time the other tasks take. A task that is a whole period or more late has missed its deadline: the miss is
+  counted and the task starts over one period from now instead of running the missed periods back to back.
+  The blocking motion functions (runToStop() and friends) call run() while they wait, so the other tasks keep going
+  during them. A task that is already running is skipped, the command that started a blocking move does not read
+  the next command from inside it.
+
+  The primary functions created are
+  begin - give the scheduler its task table, every task is due at once
+  run - one pass down the table, call it from loop() and wherever the firmware waits
+  print - runs, missed deadlines, run time and lateness of each task since the last print, then starts them over
+
+  Key variables
+  Task - one table entry: name, function to call, period in us
+  TaskStat - runs, misses, total and longest run time in CPU cycles and the most a run started late in us
+  SCHEDULER_MAX_TASKS - longest task table
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS 12  //tasks in the table at most
+
+//one entry of the task table
+struct Task {
+  const char *name;                  //name in the task report
+  void (*run)();                     //function to call when it is due
+  unsigned long period;              //us between runs, 0 runs it every pass
+};
+
+struct TaskStat {
+  uint32_t runs;                     //times it ran
+  uint32_t misses;                   //deadlines missed, a period or more late
+  uint32_t total;                    //cycles, all runs added up (includes the tasks a blocking run let through)
+  uint32_t max;                      //cycles, longest run
+  unsigned long late;                //us, most a run started after it was due
+};
+
+class Scheduler {
+public:
+  void begin(const Task *table, uint8_t count);
+  void run();
+  void print(Print &port);
+
+private:
+  const Task *tasks;                         //task table
+  uint8_t taskCount;                         //entries in the table
+  unsigned long due[SCHEDULER_MAX_TASKS];    //micros() each task is due next
+  bool running[SCHEDULER_MAX_TASKS];         //the task is on the stack, a blocking move inside it called run()
+  TaskStat stats[SCHEDULER_MAX_TASKS];
+};
+
+extern Scheduler scheduler;   //the one scheduler, run by loop()
+
+#endif
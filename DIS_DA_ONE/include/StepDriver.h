@@ -0,0 +1,96 @@
+/*
+  StepDriver.h
+  Kyzer Bowen, Tyce Miller
+
+  Low level step and direction outputs for the two A4988 drivers. All four motor pins are on PORTB of the Mega,
+  so both step bits (or both direction bits) change in one register write instead of four digitalWrite() calls.
+  That makes the left and right step edges land on the same clock cycle and each step costs a few cycles
+  instead of a few microseconds.
+
+  Arduino pin mappings: https://www.arduino.cc/en/Hacking/PinMapping2560
+  A4988 timing: https://www.pololu.com/product/1182 (STEP high and low at least 1 us, DIR set 200 ns before STEP)
+
+  digital pin 50 - PB3 - right stepper motor step pin
+  digital pin 51 - PB2 - right stepper motor direction pin
+  digital pin 52 - PB1 - left stepper motor step pin
+  digital pin 53 - PB0 - left stepper motor direction pin
+
+  The primary functions created are
+  stepDriverBegin - make the four pins outputs and drive them low
+  stepHigh, stepLow - raise or drop the step pins in a mask with one write
+  stepPulse - one step pulse on every pin in the mask, held high long enough for the A4988
+  setDirBits - set both direction pins with one write
+  rightStepForward, rightStepBackward, leftStepForward, leftStepBackward - AccelStepper FUNCTION interface step callbacks
+*/
+
+#ifndef STEP_DRIVER_H
+#define STEP_DRIVER_H
+
+#include <Arduino.h>
+#include <util/delay.h>
+
+//PORTB bits for the motor pins, these must match rtStepPin, rtDirPin, ltStepPin and ltDirPin in RobotConfig.h
+#define RT_STEP_BIT _BV(PB3)   //digital pin 50
+#define RT_DIR_BIT _BV(PB2)    //digital pin 51
+#define LT_STEP_BIT _BV(PB1)   //digital pin 52
+#define LT_DIR_BIT _BV(PB0)    //digital pin 53
+#define STEP_BITS (RT_STEP_BIT | LT_STEP_BIT)
+#define DIR_BITS (RT_DIR_BIT | LT_DIR_BIT)
+
+#define STEP_PULSE_US 1.5   //step pin high time, A4988 needs at least 1 us
+#define DIR_SETUP_US 0.25   //direction change to step edge, A4988 needs at least 200 ns
+
+//function to make the step and direction pins outputs and drive them low
+inline void stepDriverBegin() {
+  uint8_t sreg = SREG;
+  cli();
+  DDRB |= STEP_BITS | DIR_BITS;
+  PORTB &= ~(STEP_BITS | DIR_BITS);
+  SREG = sreg;
+}
+
+//function to raise the step pins in the mask with one register write
+inline void stepHigh(uint8_t mask) {
+  uint8_t sreg = SREG;
+  cli();
+  PORTB |= mask;
+  SREG = sreg;
+}
+
+//function to drop the step pins in the mask with one register write
+inline void stepLow(uint8_t mask) {
+  uint8_t sreg = SREG;
+  cli();
+  PORTB &= ~mask;
+  SREG = sreg;
+}
+
+//function to make one step on every wheel in the mask, both edges land on the same cycle
+inline void stepPulse(uint8_t mask) {
+  stepHigh(mask);
+  _delay_us(STEP_PULSE_US);  //minimum pulse width for the A4988
+  stepLow(mask);
+}
+
+/*
+  Sets both direction pins with one register write, forwardMask holds the DIR bits that should be high (forward).
+  Only the bits in changeMask are touched, waits out the A4988 setup time if a pin actually changed.
+*/
+inline void setDirBits(uint8_t changeMask, uint8_t forwardMask) {
+  uint8_t sreg = SREG;
+  cli();
+  uint8_t port = PORTB;
+  uint8_t next = (port & ~changeMask) | (forwardMask & changeMask);
+  PORTB = next;
+  SREG = sreg;
+  if (next != port) {
+    _delay_us(DIR_SETUP_US);
+  }
+}
+
+void rightStepForward();
+void rightStepBackward();
+void leftStepForward();
+void leftStepBackward();
+
+#endif
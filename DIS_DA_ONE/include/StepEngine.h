@@ -0,0 +1,74 @@
+/*
+  StepEngine.h
+  Kyzer Bowen, Tyce Miller
+
+  Interrupt driven step generation for both wheels. Timer1 free runs at 2 MHz and each wheel owns one of its
+  output compare channels (A = right wheel, B = left wheel). Every compare interrupt emits one step pulse and
+  schedules the next one, so step timing no longer depends on how fast the main loop polls run().
+  Foreground code hands the engine AccelStepper style targets and the ISRs do the rest. The ramps are planned in
+  float in the foreground, the ISRs only do integer math and a flash table lookup per step.
+
+  The primary functions created are
+  begin - set up the step/direction pins (StepDriver.h) and start Timer1
+  moveTo, move - accelerate/decelerate to an absolute or relative target (like AccelStepper::run())
+  chain - queue the next move of both wheels behind the current one so they go through the junction without stopping
+  chained - true while the chained move is still waiting
+  moveLinked - move both wheels as one coordinated move, the step ratio between them holds through the whole ramp
+  chainLinked - queue the next linked move behind the current one
+  setSpeed - run continuously at a constant signed speed (like AccelStepper::runSpeed())
+  setMaxSpeed, setAcceleration - ramp parameters in steps/s and steps/s^2
+  setJerk - turn the ramps into jerk limited S-curves (steps/s^3), 0 for the constant acceleration ramps
+  stoppingSteps, stoppingSpeed - steps needed to stop from a speed and back, for planning junction speeds
+  stop - decelerate to a stop as quickly as the acceleration allows
+  halt - stop both wheels immediately
+  isRunning - true while a wheel still has steps to make
+  direction - direction of the last step, lets the encoders put a sign on their speed
+
+  Key variables
+  STEP_TIMER_HZ - Timer1 tick rate, 0.5 us per tick
+  STEP_MIN_INTERVAL - shortest step interval the ISRs are allowed to schedule
+  STEP_MAX_ACCELERATION, STEP_MAX_JERK - largest ramp settings the ISR's integer math has room for
+*/
+
+#ifndef STEP_ENGINE_H
+#define STEP_ENGINE_H
+
+#include <Arduino.h>
+
+#define STEP_TIMER_HZ 2000000UL   //Timer1 tick rate with the /8 prescaler
+#define STEP_MIN_INTERVAL 100     //shortest step interval in timer ticks (50 us, 20000 steps/s)
+#define STEP_MAX_ACCELERATION 30000.0   //steps/s^2
+#define STEP_MAX_JERK 900000.0          //steps/s^3
+
+class StepEngine {
+public:
+  void begin();
+
+  void moveTo(uint8_t wheel, long absolute);
+  void move(uint8_t wheel, long relative);
+  bool chain(const long relative[2], const float maxSpeed[2], const float junctionSpeed[2]);
+  bool chained(uint8_t wheel);
+  bool moveLinked(const long steps[2], float maxSpeed);
+  bool chainLinked(const long steps[2], float maxSpeed, float junctionSpeed);
+  void setSpeed(uint8_t wheel, float speed);
+  void setMaxSpeed(uint8_t wheel, float speed);
+  void setAcceleration(uint8_t wheel, float acceleration);
+  void setJerk(uint8_t wheel, float jerk);
+  float stoppingSteps(uint8_t wheel, float speed);
+  float stoppingSpeed(uint8_t wheel, float steps);
+  void stop(uint8_t wheel);
+  void halt();
+
+  long currentPosition(uint8_t wheel);
+  void setCurrentPosition(uint8_t wheel, long position);
+  long targetPosition(uint8_t wheel);
+  long distanceToGo(uint8_t wheel);
+  float speed(uint8_t wheel);
+  int8_t direction(uint8_t wheel);
+  bool isRunning(uint8_t wheel);
+  bool isRunning();
+};
+
+extern StepEngine stepEngine;   //the one step engine, shared by every motion function
+
+#endif
@@ -0,0 +1,79 @@
+/*
+  Telemetry.h
+  Kyzer Bowen, Tyce Miller
+
+  Binary telemetry stream, replaces the text prints for logging while the robot moves. Each channel (encoders,
+  IMU, step engine, pose) has its own rate, 0 turns it off. When a channel is due update() packs its values into
+  a packet, adds a CRC and COBS frames it, so a 0 byte only ever marks the end of a frame and the host can pick up
+  the stream at any point. A frame is only written if it fits in the serial transmit buffer right now, otherwise it
+  is dropped and counted, so telemetry never stalls the loop.
+  Text printed to the telemetry object (command replies while a channel streams on the same port) goes out as
+  TELEMETRY_TEXT packets a line or TELEMETRY_MAX_PAYLOAD bytes at a time, so it cannot break a frame in two. Text
+  frames wait for buffer space like a println() would instead of being dropped.
+  COBS: https://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
+  Host side decoder: tools/telemetry_decode.py
+
+  Packet before framing (little endian, the AVR byte order):
+  channel (1 byte), sequence (1 byte, counts up per channel), millis() (4 bytes), payload, CRC-16/XMODEM (2 bytes)
+
+  Payloads
+  TELEMETRY_ENCODERS - int32_t ticks[LEFT], ticks[RIGHT], fix16 speed[LEFT], speed[RIGHT] (cm/s)
+  TELEMETRY_IMU - int16_t accel x y z, temperature, gyro x y z (raw counts, see Imu.h), uint16_t samples lost
+  TELEMETRY_STEPPERS - int32_t position[LEFT], position[RIGHT], int32_t distanceToGo[LEFT], distanceToGo[RIGHT] (steps)
+  TELEMETRY_POSE - fix16 x, y (cm), heading (degrees)
+  TELEMETRY_TEXT - up to TELEMETRY_MAX_PAYLOAD characters, a line ends with '\n'
+
+  The primary functions created are
+  begin - pick the port the frames go out on (Serial or bluetooth), every channel starts off
+  setRate - packets per second for one channel up to TELEMETRY_MAX_HZ, 0 to stop it
+  update - send whatever channels are due, the telemetry task in main.cpp calls it every 5 ms
+  dropped - frames skipped because the transmit buffer was full
+  output - where text meant for a port goes, the text channel while a channel streams on that port
+  write - text for the TELEMETRY_TEXT channel (Print, so print() and println() work on it)
+
+  Key variables
+  TELEMETRY_MAX_PAYLOAD - largest payload of any channel
+  TELEMETRY_MAX_HZ - fastest rate of a channel, the telem task runs every 5 ms
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+//channel ids, also the first byte of every packet
+#define TELEMETRY_ENCODERS 0
+#define TELEMETRY_IMU 1
+#define TELEMETRY_STEPPERS 2
+#define TELEMETRY_POSE 3
+#define TELEMETRY_TEXT 4           //text written to the telemetry object, no rate of its own
+#define TELEMETRY_CHANNELS 5
+
+#define TELEMETRY_MAX_PAYLOAD 16   //bytes, the encoder and stepper payloads
+#define TELEMETRY_MAX_HZ 200       //packets per second, one per run of the 5 ms telem task
+
+class Telemetry : public Print {
+public:
+  void begin(Stream &serial);
+  void setRate(uint8_t channel, unsigned int hz);
+  void update();
+  unsigned int dropped();
+  Print &output(Print &text);
+  size_t write(uint8_t byte);
+  using Print::write;
+
+private:
+  void send(uint8_t channel, const void *payload, uint8_t length);
+
+  Stream *port;                                //where the frames go, 0 before begin()
+  unsigned int period[TELEMETRY_CHANNELS];     //ms between packets, 0 when the channel is off
+  unsigned long lastSent[TELEMETRY_CHANNELS];  //millis() of the last packet
+  uint8_t sequence[TELEMETRY_CHANNELS];        //next sequence number, lets the host count lost frames
+  unsigned int skipped;                        //frames dropped for lack of buffer space
+  uint8_t text[TELEMETRY_MAX_PAYLOAD];         //text line waiting to be sent
+  uint8_t textLength;                          //characters in text
+};
+
+extern Telemetry telemetry;   //the one telemetry stream
+
+#endif
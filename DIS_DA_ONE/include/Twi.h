@@ -0,0 +1,48 @@
+/*
+  Twi.h
+  Kyzer Bowen, Tyce Miller
+
+  Interrupt driven I2C (TWI) master. A transfer is handed to twiStart() and the TWI interrupt walks it through
+  start, address, register, data and stop one byte at a time, so nothing waits on the bus. When the transfer ends
+  its done function is called from the interrupt, which can start the next transfer right away.
+  This replaces the Wire library (Wire owns the TWI interrupt, the two cannot be linked together).
+  ATmega2560 datasheet, section 24 (2-wire Serial Interface)
+
+  digital pin 20 - SDA
+  digital pin 21 - SCL
+
+  The primary functions created are
+  twiBegin - set the bus clock (400 kHz fast mode for the MPU6050) and turn the TWI on
+  twiStart - start a register read or write in the background, false if the bus is still busy
+  twiBusy - true while a transfer is running
+  twiWriteRegister, twiReadRegisters - blocking versions for setup code, give up after TWI_TIMEOUT_MS
+
+  Key variables
+  TwiTransfer - one register read or write, must stay in memory until it is done
+*/
+
+#ifndef TWI_H
+#define TWI_H
+
+#include <Arduino.h>
+
+#define TWI_TIMEOUT_MS 10   //blocking transfers give up after this long
+
+//one register read or write on the bus
+struct TwiTransfer {
+  uint8_t address;          //7 bit device address
+  uint8_t reg;              //first register
+  uint8_t *data;            //bytes to write, or buffer to read into
+  uint8_t length;           //number of data bytes
+  bool read;                //true to read from the device
+  void (*done)(bool ok);    //called from the TWI interrupt when the transfer ends, can be 0
+};
+
+void twiBegin(unsigned long hz);
+bool twiStart(TwiTransfer *transfer);
+bool twiBusy();
+unsigned int twiErrors();
+bool twiWriteRegister(uint8_t address, uint8_t reg, uint8_t value);
+bool twiReadRegisters(uint8_t address, uint8_t reg, uint8_t *data, uint8_t length);
+
+#endif
@@ -0,0 +1,64 @@
+/*
+  WheelControl.h
+  Kyzer Bowen, Tyce Miller
+
+  Closed loop wheel control for motion segments flagged SEG_CORRECT. Every CONTROL_PERIOD_US the controller
+  compares the encoder ticks each wheel has counted with the ticks it should have counted for the steps made so far.
+  The tick error goes through a PID that trims the wheel's cruise speed, and the steps the encoders did not see
+  (slip) are added to the wheel's step target. The move ends on the encoder distance in one pass instead of
+  stopping, measuring and making a second corrective move.
+
+  The primary functions created are
+  setGains - PID gains, speed trim in steps/s per tick of error
+  start - begin tracking a segment, called by the motion queue when the segment starts
+  update - run one control period, the wheel task in main.cpp calls it every CONTROL_PERIOD_US
+  stop - stop trimming (queue cleared or segment finished)
+  settled - true once both wheels have stopped within one encoder tick of the goal (or the correction hit its limit)
+
+  Key variables
+  CONTROL_PERIOD_US - control period, 5000 us = 200 Hz
+  CONTROL_MAX_TRIM - largest speed trim in percent of the segment speed, the PID output saturates here
+  CONTROL_MAX_EXTRA - largest slip correction in percent of the segment steps, keeps a dead encoder from running away
+*/
+
+#ifndef WHEEL_CONTROL_H
+#define WHEEL_CONTROL_H
+
+#include <Arduino.h>
+#include "FixedKinematics.h"
+#include "MotionQueue.h"
+
+#define CONTROL_PERIOD_US 5000UL   //200 Hz
+#define CONTROL_MAX_TRIM 25        //percent of the segment speed
+#define CONTROL_MAX_EXTRA 25       //percent of the segment steps
+
+class WheelController {
+public:
+  void begin();
+  void setGains(fix16 kp, fix16 ki, fix16 kd);
+  void start(const MotionSegment &segment);
+  void update();
+  void stop();
+  bool settled();
+  fix16 error(uint8_t wheel);
+
+private:
+  void control(uint8_t wheel);
+
+  fix16 kp, ki, kd;              //speed trim in steps/s per tick, per tick*s and per tick/s
+  bool active;                   //a segment is being tracked
+  long startPos[2];              //step position when the segment started
+  long startTicks[2];            //encoder total when the segment started
+  long steps[2];                 //signed steps of the segment
+  fix16 goalTicks;               //encoder ticks each moving wheel should count (Q16.16)
+  fix16 ticksPerStep[2];         //goalTicks / steps for each wheel
+  float speed[2];                //segment speed in steps/s before trimming
+  fix16 err[2];                  //tick error from the last period, reference - counted
+  fix16 integral[2];             //integral of the error in tick*s
+  long extra[2];                 //slip steps added to the step target
+  bool done[2];                  //wheel stopped and on the goal
+};
+
+extern WheelController wheelControl;   //the one wheel controller, started by the motion queue, run by the wheel task
+
+#endif
@@ -0,0 +1,65 @@
+/*
+  AccelStepper.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the AccelStepper library for the native build (see Sim.h). Only the FUNCTION interface the firmware uses
+  is there: the step callbacks go through the PORTB driver in StepDriver.h, so the sim sees the steps the same way
+  it sees the step engine's. The speed ramp is the library's own (AccelStepper::computeNewSpeed()), polled from
+  micros() like on the Mega.
+  http://www.airspayce.com/mikem/arduino/AccelStepper/
+*/
+
+#ifndef SIM_ACCEL_STEPPER_H
+#define SIM_ACCEL_STEPPER_H
+
+#include <Arduino.h>
+
+class AccelStepper {
+public:
+  typedef enum {
+    FUNCTION = 0,
+    DRIVER = 1
+  } MotorInterfaceType;
+
+  AccelStepper(void (*forward)(), void (*backward)());
+
+  void moveTo(long absolute);
+  void move(long relative);
+  boolean run();
+  boolean runSpeed();
+  void setMaxSpeed(float speed);
+  float maxSpeed();
+  void setAcceleration(float acceleration);
+  void setSpeed(float speed);
+  float speed();
+  long distanceToGo();
+  long targetPosition();
+  long currentPosition();
+  void setCurrentPosition(long position);
+  void runToPosition();
+  boolean runSpeedToPosition();
+  void runToNewPosition(long position);
+  void stop();
+  bool isRunning();
+
+private:
+  unsigned long computeNewSpeed();
+  void step();
+
+  void (*forward)();
+  void (*backward)();
+  bool clockwise;                //direction of the next step
+  long currentPos;               //steps
+  long targetPos;                //steps
+  float speedNow;                //steps/s, negative is backward
+  float maxSpeedSet;             //steps/s
+  float acceleration;            //steps/s^2
+  unsigned long stepInterval;    //us, 0 when stopped
+  unsigned long lastStepTime;    //micros() of the last step
+  long n;                        //step counter of the ramp, negative while decelerating
+  float c0;                      //first step interval (us)
+  float cn;                      //last step interval (us)
+  float cmin;                    //interval at max speed (us)
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+  Arduino.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the parts of the Arduino AVR core the firmware uses, for the native build (see Sim.h).
+  Time comes from the simulated clock, attachInterrupt() hooks the pins the sim raises edges on, and Serial is the
+  serial monitor of the sim (its output goes to stdout, its input comes from the sim's script).
+  Print and Stream follow the core's class layout so UsartStream in Bluetooth.h builds unchanged.
+*/
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define SDA 20
+#define SCL 21
+
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 4 : ((p) == 3 ? 5 : ((p) >= 18 && (p) <= 21 ? 21 - (p) : NOT_AN_INTERRUPT)))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x) ((x) * (x))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bit(b) (1UL << (b))
+#define F(string) (string)
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+//min and max as functions, the core's macros would break the C++ library headers the sim uses
+template <class A, class B> inline auto min(A a, B b) -> decltype(a < b ? a : b) {
+  return a < b ? a : b;
+}
+template <class A, class B> inline auto max(A a, B b) -> decltype(a > b ? a : b) {
+  return a > b ? a : b;
+}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t byte) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *text);
+  size_t write(const char *buffer, size_t size);
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const char *text);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println();
+  size_t println(const char *text);
+  size_t println(char c);
+  size_t println(unsigned char value, int base = DEC);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned int value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t println(double value, int digits = 2);
+
+private:
+  size_t printNumber(unsigned long value, int base);
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+//the serial monitor, written straight through to stdout
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud);
+  void end();
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t byte);
+  int availableForWrite();
+  void flush();
+  operator bool();
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,29 @@
+/*
+  MultiStepper.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the AccelStepper library's MultiStepper for the native build (see Sim.h), same constant speed
+  coordination as the library: every stepper gets the speed that makes it arrive with the slowest one.
+*/
+
+#ifndef SIM_MULTI_STEPPER_H
+#define SIM_MULTI_STEPPER_H
+
+#include <AccelStepper.h>
+
+#define MULTISTEPPER_MAX_STEPPERS 10
+
+class MultiStepper {
+public:
+  MultiStepper();
+  boolean addStepper(AccelStepper &stepper);
+  void moveTo(long absolute[]);
+  boolean run();
+  void runSpeedToPosition();
+
+private:
+  AccelStepper *steppers[MULTISTEPPER_MAX_STEPPERS];
+  uint8_t count;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*
+  Sim.h
+  Kyzer Bowen, Tyce Miller
+
+  Host side stand in for the Mega and the robot, used by the native build (pio run -e native). The firmware in src/
+  is compiled unchanged against the mock AVR and Arduino headers in sim/include, and the files in sim/src play the
+  hardware: Timer1 compare interrupts, the step pins on PORTB, the encoder and IMU INT pins, the TWI bus with an
+  MPU6050 on it, USART2 with the HC-05 and the serial monitor. A differential drive model turns the step pulses into
+  wheel travel, encoder ticks, gyro samples and the true pose of the robot.
+
+  Time is simulated, there is no real clock. It only moves when the firmware waits for it: delay(), _delay_us(),
+  and every micros()/millis() call (SIM_CALL_CYCLES each, so polling loops see time pass). Interrupts that come due
+  while the clock moves run right there, or as soon as interrupts are turned back on, so the ISRs interleave with
+  the foreground the way they do on the Mega. Nothing is ever slept, which is why the sim runs faster than real time.
+  The native32 env builds with -m32 (sim/m32.py) so longs are 32 bits and the fixed point and ramp math overflows
+  where it would on the Mega, it needs the 32 bit C library. The native env builds for the host as it is and warns
+  on a 64 bit host, its longs hide that overflow. Host ints stay 32 bits either way, code that relies on a 16 bit int
+  overflowing will not match.
+
+  The primary functions created are
+  simAdvance - move the clock forward, running every interrupt that comes due on the way
+  simDeliver - run the interrupts waiting for interrupts to be turned on
+  simRaise - flag an interrupt vector, simRaisePin - an edge on an external interrupt pin
+  simSchedule, simCancel - one shot events of the simulated hardware (TWI byte done, USART byte in, IMU sample ...)
+  simRobotStep, simRobotPose - drive model, called by the PORTB hook for every step pulse
+  simImuBegin - MPU6050 model, power on reset of its registers and FIFO
+  simSerialInput, simBluetoothInput - type bytes into the serial monitor or the HC-05
+  simEepromLoad, simEepromSave - keep the EEPROM in a file between runs
+
+  Key variables
+  simNow - CPU cycles since reset (16 MHz)
+  SimRobotModel - the real robot the firmware drives, its wheels and track can differ from RobotConfig.h
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#define SIM_CPU_HZ 16000000ULL   //Mega clock
+#define SIM_CALL_CYCLES 64       //cycles a micros() or millis() call takes (4 us), so polling loops move the clock
+#define SIM_US(us) ((SimTime)((us) * (SIM_CPU_HZ / 1000000.0) + 0.5))
+
+typedef uint64_t SimTime;   //CPU cycles
+
+//interrupt vectors in AVR priority order (lowest vector number first)
+enum SimVector {
+  SIM_INT0, SIM_INT1, SIM_INT2, SIM_INT3, SIM_INT4, SIM_INT5, SIM_INT6, SIM_INT7,
+  SIM_TIMER1_COMPA, SIM_TIMER1_COMPB, SIM_TIMER1_OVF,
+  SIM_TWI,
+  SIM_TIMER5_OVF,
+  SIM_USART2_RX, SIM_USART2_UDRE,
+  SIM_VECTORS
+};
+
+//one shot event of the simulated hardware
+struct SimEvent {
+  SimTime when;        //cycle it fires on
+  void (*fire)();      //what happens then, runs in whatever context the clock moved in
+  bool armed;          //waiting to fire
+};
+
+//the robot on the simulated floor
+struct SimRobotModel {
+  double wheelDiam;    //cm, true wheel diameter
+  double trackWidth;   //cm, true distance between the wheel contact points
+  double gyroBias;     //degrees/s the gyro reads at rest
+  bool imuPresent;     //the MPU6050 answers on the bus
+  double slip[2];      //share of each wheel's travel lost to slip, the encoder turns with the wheel and still counts it
+};
+
+extern SimTime simNow;
+extern SimRobotModel simRobot;
+
+void simAdvance(SimTime cycles);
+void simDeliver();
+bool simInterruptsOn();
+void simRaise(SimVector vector);
+void simRaisePin(uint8_t pin, bool rising);
+void simSchedule(SimEvent &event, SimTime when);
+void simCancel(SimEvent &event);
+
+void simRobotBegin();
+void simRobotStep(uint8_t wheel, int8_t dir);
+void simRobotPose(double *x, double *y, double *heading);
+long simRobotSteps(uint8_t wheel);
+
+void simImuBegin();
+
+void simSerialInput(const char *text);
+bool simSerialPending();
+void simBluetoothInput(const char *text);
+bool simBluetoothPending();
+void simSerialEcho(bool on);
+
+void simEepromLoad(const char *path);
+void simEepromSave(const char *path);
+
+#endif
@@ -0,0 +1,26 @@
+/*
+  avr/eeprom.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the avr-libc EEPROM access for the native build (see Sim.h). The 4 KB EEPROM of the ATmega2560 is an array
+  in SimEeprom.cpp that starts erased (0xFF), --eeprom file keeps it in a file between runs. Writes take no time.
+*/
+
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define E2END 0x0FFF   //last EEPROM address
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+uint16_t eeprom_read_word(const uint16_t *address);
+void eeprom_read_block(void *destination, const void *source, size_t size);
+void eeprom_write_byte(uint8_t *address, uint8_t value);
+void eeprom_update_byte(uint8_t *address, uint8_t value);
+void eeprom_update_word(uint16_t *address, uint16_t value);
+void eeprom_write_block(const void *source, void *destination, size_t size);
+void eeprom_update_block(const void *source, void *destination, size_t size);
+
+#endif
@@ -0,0 +1,26 @@
+/*
+  avr/interrupt.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the avr-libc interrupt macros for the native build (see Sim.h). An ISR is a plain function the sim calls
+  by its vector name when the interrupt comes due.
+*/
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector) extern "C" void vector(void)
+
+//function to turn interrupts off, like the cli instruction
+inline void cli() {
+  SREG.value &= ~_BV(SREG_I);
+}
+
+//function to turn interrupts on, anything that came due meanwhile runs now
+inline void sei() {
+  SREG |= _BV(SREG_I);
+}
+
+#endif
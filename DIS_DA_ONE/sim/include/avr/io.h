@@ -0,0 +1,160 @@
+/*
+  avr/io.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the ATmega2560 registers the firmware touches, for the native build (see Sim.h).
+  Registers whose reads or writes do something in the hardware (PORTB raises steps, TWCR drives the bus, UDR2 sends a
+  byte, TCNT1 and TCNT5 count on their own, SREG turns interrupts on) are SimReg objects that call into the sim.
+  The rest are plain variables the sim reads when it needs them. The compare registers stay plain because the step
+  engine binds references to them.
+*/
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define _BV(bit) (1 << (bit))
+
+//8 bit register with hardware behind it
+class SimReg8 {
+public:
+  SimReg8(uint8_t (*onRead)(uint8_t value), void (*onWrite)(uint8_t before, uint8_t after));
+  operator uint8_t() const;
+  SimReg8 &operator=(uint8_t value);
+  SimReg8 &operator|=(uint8_t bits);
+  SimReg8 &operator&=(uint8_t bits);
+  SimReg8 &operator^=(uint8_t bits);
+
+  uint8_t value;   //what was last written, for the sim
+
+private:
+  SimReg8(const SimReg8 &);
+  uint8_t (*readHook)(uint8_t value);
+  void (*writeHook)(uint8_t before, uint8_t after);
+};
+
+//16 bit register with hardware behind it
+class SimReg16 {
+public:
+  SimReg16(uint16_t (*onRead)(), void (*onWrite)(uint16_t value));
+  operator uint16_t() const;
+  SimReg16 &operator=(uint16_t value);
+
+private:
+  SimReg16(const SimReg16 &);
+  uint16_t (*readHook)();
+  void (*writeHook)(uint16_t value);
+};
+
+extern SimReg8 SREG;
+extern volatile uint8_t MCUSR;
+
+extern SimReg8 PORTB;
+extern volatile uint8_t DDRB;
+extern volatile uint8_t PINB;
+
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern SimReg16 TCNT1;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t OCR1B;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t TIFR1;
+
+extern volatile uint8_t TCCR5A;
+extern volatile uint8_t TCCR5B;
+extern SimReg16 TCNT5;
+extern volatile uint8_t TIMSK5;
+extern SimReg8 TIFR5;
+
+extern volatile uint8_t TWBR;
+extern volatile uint8_t TWSR;
+extern volatile uint8_t TWDR;
+extern SimReg8 TWCR;
+
+extern SimReg8 UCSR2A;
+extern SimReg8 UCSR2B;
+extern volatile uint8_t UCSR2C;
+extern volatile uint16_t UBRR2;
+extern SimReg8 UDR2;
+
+#define SREG_I 7
+
+//MCUSR, reset cause
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define JTRF 4
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+//Timer1
+#define WGM10 0
+#define WGM11 1
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCIE1C 3
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define OCF1C 3
+
+//Timer5
+#define CS50 0
+#define CS51 1
+#define CS52 2
+#define TOIE5 0
+#define TOV5 0
+
+//TWI
+#define TWIE 0
+#define TWEN 2
+#define TWWC 3
+#define TWSTO 4
+#define TWSTA 5
+#define TWEA 6
+#define TWINT 7
+#define TWPS0 0
+#define TWPS1 1
+
+//USART2
+#define MPCM2 0
+#define U2X2 1
+#define UPE2 2
+#define DOR2 3
+#define FE2 4
+#define UDRE2 5
+#define TXC2 6
+#define RXC2 7
+#define TXB82 0
+#define RXB82 1
+#define UCSZ22 2
+#define TXEN2 3
+#define RXEN2 4
+#define UDRIE2 5
+#define TXCIE2 6
+#define RXCIE2 7
+#define UCPOL2 0
+#define UCSZ20 1
+#define UCSZ21 2
+
+#endif
@@ -0,0 +1,26 @@
+/*
+  avr/pgmspace.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the avr-libc flash access for the native build (see Sim.h), the host has one address space so PROGMEM
+  data is ordinary const data and the pgm_read functions are plain reads.
+*/
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_float(address) (*(const float *)(address))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strcmp_P strcmp
+#define strlen_P strlen
+
+#endif
@@ -0,0 +1,39 @@
+/*
+  util/atomic.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the avr-libc ATOMIC_BLOCK for the native build (see Sim.h). The block turns interrupts off and puts SREG
+  back when it ends, however it ends, so interrupts that came due inside it run right after it like on the Mega.
+*/
+
+#ifndef SIM_UTIL_ATOMIC_H
+#define SIM_UTIL_ATOMIC_H
+
+#include <avr/interrupt.h>
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+
+//interrupts off for the life of the object
+class SimAtomic {
+public:
+  explicit SimAtomic(int type) : restore(type == ATOMIC_FORCEON ? (uint8_t)(SREG | _BV(SREG_I)) : (uint8_t)SREG), once(true) {
+    cli();
+  }
+  ~SimAtomic() {
+    SREG = restore;
+  }
+  bool first() {
+    bool run = once;
+    once = false;
+    return run;
+  }
+
+private:
+  uint8_t restore;
+  bool once;
+};
+
+#define ATOMIC_BLOCK(type) for (SimAtomic simAtomic(type); simAtomic.first();)
+
+#endif
@@ -0,0 +1,25 @@
+/*
+  util/crc16.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the avr-libc CRC helpers for the native build (see Sim.h), the C versions given in the avr-libc manual.
+*/
+
+#ifndef SIM_UTIL_CRC16_H
+#define SIM_UTIL_CRC16_H
+
+#include <stdint.h>
+
+inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data) {
+  crc = crc ^ ((uint16_t)data << 8);
+  for (uint8_t i = 0; i < 8; i++) {
+    if (crc & 0x8000) {
+      crc = (crc << 1) ^ 0x1021;
+    } else {
+      crc <<= 1;
+    }
+  }
+  return crc;
+}
+
+#endif
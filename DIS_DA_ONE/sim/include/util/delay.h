@@ -0,0 +1,21 @@
+/*
+  util/delay.h
+  Kyzer Bowen, Tyce Miller
+
+  Mock of the avr-libc busy wait for the native build (see Sim.h), the wait moves the simulated clock.
+*/
+
+#ifndef SIM_UTIL_DELAY_H
+#define SIM_UTIL_DELAY_H
+
+#include "Sim.h"
+
+inline void _delay_us(double us) {
+  simAdvance(SIM_US(us));
+}
+
+inline void _delay_ms(double ms) {
+  simAdvance(SIM_US(ms * 1000.0));
+}
+
+#endif
@@ -0,0 +1,13 @@
+"""
+  m32.py
+  Kyzer Bowen, Tyce Miller
+
+  PlatformIO extra script of the native32 env (platformio.ini). Compiles and links the simulator as 32 bit code so
+  long is 32 bits like on the AVR, the fixed point and step ramp math overflows where it would on the Mega.
+  build_flags only reach the compiler, -m32 has to be on the link line too.
+  Needs the 32 bit C library (gcc-multilib / g++-multilib on Debian and Ubuntu).
+"""
+
+Import("env")
+
+env.Append(CCFLAGS=["-m32"], LINKFLAGS=["-m32"])
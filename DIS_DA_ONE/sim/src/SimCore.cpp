@@ -0,0 +1,408 @@
+/*
+  SimCore.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Simulated clock and interrupt controller of the native build, see Sim.h.
+  simAdvance() walks the clock from event to event: Timer1 compare and overflow matches and Timer5 overflows worked
+  out from the timer registers, and the one shot events the other hardware schedules. Each event flags its vector,
+  and the flagged vectors run in AVR priority order whenever interrupts are on and no ISR is running, with
+  interrupts off inside the ISR like on the Mega. The timers count from the clock, so TCNT1 and TCNT5 are always
+  current when the firmware reads them.
+*/
+
+#include <stdio.h>
+#include "Sim.h"
+#include <Arduino.h>
+
+#if __SIZEOF_LONG__ != 4
+#warning "long is not 32 bits like on the AVR, build with -m32 (pio run -e native32) or long overflow in the firmware goes unseen"
+#endif
+
+#define MAX_EVENTS 16   //one shot events that can be waiting at once
+#define PIN_COUNT 70    //digital pins on the Mega
+
+//ISRs the firmware may define, the sim skips the ones it does not
+extern "C" {
+void TIMER1_COMPA_vect(void) __attribute__((weak));
+void TIMER1_COMPB_vect(void) __attribute__((weak));
+void TIMER1_OVF_vect(void) __attribute__((weak));
+void TIMER5_OVF_vect(void) __attribute__((weak));
+void TWI_vect(void) __attribute__((weak));
+void USART2_RX_vect(void) __attribute__((weak));
+void USART2_UDRE_vect(void) __attribute__((weak));
+}
+
+SimTime simNow = 0;
+static bool flagged[SIM_VECTORS];          //interrupt flags waiting for their ISR
+static bool inInterrupt = false;           //an ISR is running, nothing else may start
+static SimEvent *events[MAX_EVENTS];       //armed one shot events
+static uint8_t eventCount = 0;
+static void (*pinHandler[8])(void);        //attachInterrupt() handlers by INTn
+static int pinEdge[8];                     //CHANGE, RISING or FALLING by INTn
+static uint8_t pinLevel[PIN_COUNT];        //levels written with digitalWrite()
+static SimTime timer1Origin = 0;           //cycle Timer1 counted 0 on
+static SimTime timer5Origin = 0;           //cycle Timer5 counted 0 on
+
+extern bool simUsartRxWaiting();
+
+static void writeSreg(uint8_t before, uint8_t after) {
+  if (!(before & _BV(SREG_I)) && (after & _BV(SREG_I))) {
+    simDeliver();   //interrupts back on, anything flagged meanwhile runs now
+  }
+}
+
+SimReg8 SREG(0, writeSreg);
+
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint16_t OCR1A;
+volatile uint16_t OCR1B;
+volatile uint8_t TIMSK1;
+volatile uint8_t TIFR1;
+
+//function to return the Timer1 clock divider from its clock select bits, 0 when stopped
+static SimTime timer1Prescale() {
+  static const SimTime prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+  return prescale[TCCR1B & 0x07];
+}
+
+//function to return the Timer1 TOP, OCR1A in CTC mode (WGM 4) and 0xFFFF in normal mode
+static uint32_t timer1Top() {
+  uint8_t mode = ((TCCR1B >> WGM12) & 0x03) << 2 | (TCCR1A & 0x03);
+  return mode == 4 ? OCR1A : 0xFFFF;
+}
+
+static uint16_t timer1Count() {
+  SimTime prescale = timer1Prescale();
+  if (prescale == 0) {
+    return 0;
+  }
+  return (uint16_t)(((simNow - timer1Origin) / prescale) % (timer1Top() + 1));
+}
+
+static uint16_t readTcnt1() {
+  return timer1Count();
+}
+
+static void writeTcnt1(uint16_t value) {
+  SimTime prescale = timer1Prescale();
+  SimTime ticks = prescale ? (simNow - timer1Origin) / prescale : 0;
+  timer1Origin += (ticks - value) * (prescale ? prescale : 1);   //count is value from here on
+}
+
+SimReg16 TCNT1(readTcnt1, writeTcnt1);
+
+volatile uint8_t MCUSR = _BV(PORF);   //the sim always starts from power on
+
+volatile uint8_t TCCR5A;
+volatile uint8_t TCCR5B;
+volatile uint8_t TIMSK5;
+
+//function to return the Timer5 clock divider, Timer5 only runs free in normal mode (the profiler's cycle counter)
+static SimTime timer5Prescale() {
+  static const SimTime prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+  return prescale[TCCR5B & 0x07];
+}
+
+static uint16_t readTcnt5() {
+  SimTime prescale = timer5Prescale();
+  return prescale ? (uint16_t)((simNow - timer5Origin) / prescale) : 0;
+}
+
+static void writeTcnt5(uint16_t value) {
+  SimTime prescale = timer5Prescale();
+  SimTime ticks = prescale ? (simNow - timer5Origin) / prescale : 0;
+  timer5Origin += (ticks - value) * (prescale ? prescale : 1);
+}
+
+SimReg16 TCNT5(readTcnt5, writeTcnt5);
+
+//the overflow flag is the sim's pending interrupt flag, writing a 1 clears it
+static uint8_t readTifr5(uint8_t value) {
+  return flagged[SIM_TIMER5_OVF] ? _BV(TOV5) : 0;
+}
+
+static void writeTifr5(uint8_t before, uint8_t after) {
+  if (after & _BV(TOV5)) {
+    flagged[SIM_TIMER5_OVF] = false;
+  }
+}
+
+SimReg8 TIFR5(readTifr5, writeTifr5);
+
+//function to return the cycle Timer5 next overflows on, 0 if it is stopped
+static SimTime timer5Overflow() {
+  SimTime prescale = timer5Prescale();
+  if (prescale == 0) {
+    return 0;
+  }
+  SimTime ticks = (simNow - timer5Origin) / prescale;
+  return timer5Origin + ((ticks >> 16) + 1) * 0x10000 * prescale;
+}
+
+//function to return the cycle a Timer1 count comes around next, 0 if the timer is stopped
+static SimTime timer1Reaches(uint32_t count) {
+  SimTime prescale = timer1Prescale();
+  if (prescale == 0) {
+    return 0;
+  }
+  uint32_t period = timer1Top() + 1;
+  SimTime ticks = (simNow - timer1Origin) / prescale;
+  uint32_t now = ticks % period;
+  uint32_t ahead = (count + period - now) % period;
+  if (ahead == 0) {
+    ahead = period;   //just matched, the next match is a whole period away
+  }
+  return timer1Origin + (ticks + ahead) * prescale;
+}
+
+SimReg8::SimReg8(uint8_t (*onRead)(uint8_t value), void (*onWrite)(uint8_t before, uint8_t after))
+  : value(0), readHook(onRead), writeHook(onWrite) {
+}
+
+SimReg8::operator uint8_t() const {
+  return readHook ? readHook(value) : value;
+}
+
+SimReg8 &SimReg8::operator=(uint8_t next) {
+  uint8_t before = value;
+  value = next;
+  if (writeHook) {
+    writeHook(before, next);
+  }
+  return *this;
+}
+
+SimReg8 &SimReg8::operator|=(uint8_t bits) {
+  return *this = (uint8_t)(*this | bits);
+}
+
+SimReg8 &SimReg8::operator&=(uint8_t bits) {
+  return *this = (uint8_t)(*this & bits);
+}
+
+SimReg8 &SimReg8::operator^=(uint8_t bits) {
+  return *this = (uint8_t)(*this ^ bits);
+}
+
+SimReg16::SimReg16(uint16_t (*onRead)(), void (*onWrite)(uint16_t value)) : readHook(onRead), writeHook(onWrite) {
+}
+
+SimReg16::operator uint16_t() const {
+  return readHook();
+}
+
+SimReg16 &SimReg16::operator=(uint16_t value) {
+  writeHook(value);
+  return *this;
+}
+
+bool simInterruptsOn() {
+  return (SREG.value & _BV(SREG_I)) && !inInterrupt;
+}
+
+//function to tell if a vector's interrupt is turned on in its peripheral
+static bool enabled(int vector) {
+  switch (vector) {
+    case SIM_TIMER1_COMPA: return TIMSK1 & _BV(OCIE1A);
+    case SIM_TIMER1_COMPB: return TIMSK1 & _BV(OCIE1B);
+    case SIM_TIMER1_OVF: return TIMSK1 & _BV(TOIE1);
+    case SIM_TWI: return TWCR.value & _BV(TWIE);
+    case SIM_TIMER5_OVF: return TIMSK5 & _BV(TOIE5);
+    case SIM_USART2_RX: return (UCSR2B.value & _BV(RXCIE2)) && simUsartRxWaiting();
+    case SIM_USART2_UDRE: return (UCSR2B.value & _BV(UDRIE2)) && (UCSR2B.value & _BV(TXEN2));
+    default: return pinHandler[vector - SIM_INT0] != 0;
+  }
+}
+
+//function to run one ISR with interrupts off, like the hardware does on the way into an interrupt
+static void run(int vector) {
+  void (*isr)(void) = 0;
+  switch (vector) {
+    case SIM_TIMER1_COMPA: isr = TIMER1_COMPA_vect; break;
+    case SIM_TIMER1_COMPB: isr = TIMER1_COMPB_vect; break;
+    case SIM_TIMER1_OVF: isr = TIMER1_OVF_vect; break;
+    case SIM_TWI: isr = TWI_vect; break;
+    case SIM_TIMER5_OVF: isr = TIMER5_OVF_vect; break;
+    case SIM_USART2_RX: isr = USART2_RX_vect; break;
+    case SIM_USART2_UDRE: isr = USART2_UDRE_vect; break;
+    default: isr = pinHandler[vector - SIM_INT0]; break;
+  }
+  if (!isr) {
+    return;
+  }
+  uint8_t sreg = SREG.value;
+  inInterrupt = true;
+  SREG.value = sreg & ~_BV(SREG_I);
+  isr();
+  SREG.value = sreg;   //reti
+  inInterrupt = false;
+}
+
+//function to run flagged interrupts in priority order until none is left, level triggered ones while they hold
+void simDeliver() {
+  while (simInterruptsOn()) {
+    int next = -1;
+    for (int vector = 0; vector < SIM_VECTORS && next < 0; vector++) {
+      bool level = vector == SIM_USART2_RX || vector == SIM_USART2_UDRE;
+      if ((flagged[vector] || level) && enabled(vector)) {
+        next = vector;
+      }
+    }
+    if (next < 0) {
+      return;
+    }
+    flagged[next] = false;
+    run(next);
+  }
+}
+
+void simRaise(SimVector vector) {
+  if (enabled(vector)) {
+    flagged[vector] = true;
+  }
+}
+
+//function to put an edge on a pin, flags its external interrupt if attachInterrupt() asked for that edge
+void simRaisePin(uint8_t pin, bool rising) {
+  int interrupt = digitalPinToInterrupt(pin);
+  if (interrupt < 0 || !pinHandler[interrupt]) {
+    return;
+  }
+  int mode = pinEdge[interrupt];
+  if (mode == CHANGE || (mode == RISING && rising) || (mode == FALLING && !rising)) {
+    flagged[SIM_INT0 + interrupt] = true;
+  }
+}
+
+void simSchedule(SimEvent &event, SimTime when) {
+  if (!event.armed) {
+    if (eventCount == MAX_EVENTS) {
+      fprintf(stderr, "sim: too many events\n");
+      exit(2);
+    }
+    events[eventCount++] = &event;
+  }
+  event.when = when;
+  event.armed = true;
+}
+
+void simCancel(SimEvent &event) {
+  if (!event.armed) {
+    return;
+  }
+  event.armed = false;
+  for (uint8_t i = 0; i < eventCount; i++) {
+    if (events[i] == &event) {
+      events[i] = events[--eventCount];
+      break;
+    }
+  }
+}
+
+/*
+  Moves the clock forward by a number of cycles. At each Timer1 match or scheduled event on the way the clock stops,
+  the event flags its interrupt (or does its work) and the flagged interrupts run if they can.
+*/
+void simAdvance(SimTime cycles) {
+  SimTime target = simNow + cycles;
+  for (;;) {
+    SimTime next = target + 1;
+    SimTime match[4] = {0, 0, 0, 0};   //Timer1 compare A, compare B, overflow and Timer5 overflow
+    SimEvent *event = 0;
+    if (TIMSK1 & _BV(OCIE1A)) {
+      match[0] = timer1Reaches(OCR1A);
+    }
+    if (TIMSK1 & _BV(OCIE1B)) {
+      match[1] = timer1Reaches(OCR1B);
+    }
+    if ((TIMSK1 & _BV(TOIE1)) && timer1Top() == 0xFFFF) {
+      match[2] = timer1Reaches(0);
+    }
+    if (TIMSK5 & _BV(TOIE5)) {
+      match[3] = timer5Overflow();
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+      if (match[i] && match[i] < next) {
+        next = match[i];
+      }
+    }
+    for (uint8_t i = 0; i < eventCount; i++) {
+      if (events[i]->when < next) {
+        next = events[i]->when;
+        event = events[i];
+      }
+    }
+    if (next > target) {
+      break;
+    }
+    if (next > simNow) {
+      simNow = next;   //an ISR that waited (_delay_us() in a step pulse) may already be past it
+    }
+    if (event) {
+      simCancel(*event);
+      event->fire();
+    } else {
+      static const SimVector matchVector[4] = {SIM_TIMER1_COMPA, SIM_TIMER1_COMPB, SIM_TIMER1_OVF, SIM_TIMER5_OVF};
+      for (uint8_t i = 0; i < 4; i++) {
+        if (match[i] == next) {
+          flagged[matchVector[i]] = true;   //matches on the same tick all flag
+        }
+      }
+    }
+    simDeliver();
+  }
+  if (simNow < target) {
+    simNow = target;
+  }
+  simDeliver();
+}
+
+unsigned long micros() {
+  simAdvance(SIM_CALL_CYCLES);
+  return (unsigned long)(simNow / (SIM_CPU_HZ / 1000000));
+}
+
+unsigned long millis() {
+  simAdvance(SIM_CALL_CYCLES);
+  return (unsigned long)(simNow / (SIM_CPU_HZ / 1000));
+}
+
+void delay(unsigned long ms) {
+  simAdvance(ms * (SIM_CPU_HZ / 1000));
+}
+
+void delayMicroseconds(unsigned int us) {
+  simAdvance(us * (SIM_CPU_HZ / 1000000));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < PIN_COUNT && mode == INPUT_PULLUP) {
+    pinLevel[pin] = HIGH;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < PIN_COUNT) {
+    pinLevel[pin] = value ? HIGH : LOW;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < PIN_COUNT ? pinLevel[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode) {
+  if (interrupt < 8) {
+    pinHandler[interrupt] = handler;
+    pinEdge[interrupt] = mode;
+    flagged[SIM_INT0 + interrupt] = false;
+  }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  if (interrupt < 8) {
+    pinHandler[interrupt] = 0;
+    flagged[SIM_INT0 + interrupt] = false;
+  }
+}
@@ -0,0 +1,91 @@
+/*
+  SimEeprom.cpp
+  Kyzer Bowen, Tyce Miller
+
+  EEPROM of the native build, see Sim.h and avr/eeprom.h.
+  Addresses are EEPROM byte addresses passed as pointers like on the AVR, anything past E2END is dropped or reads 0xFF.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "Sim.h"
+#include <avr/eeprom.h>
+
+static uint8_t cells[E2END + 1];
+static bool erased = false;   //cells filled with 0xFF, done on first use so a load can come before it
+
+//function to turn an EEPROM address pointer into an index, E2END + 1 when it is out of range
+static size_t cell(const void *address) {
+  if (!erased) {
+    memset(cells, 0xFF, sizeof(cells));
+    erased = true;
+  }
+  size_t index = (size_t)address;
+  return index <= E2END ? index : E2END + 1;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *address) {
+  size_t index = cell(address);
+  return index <= E2END ? cells[index] : 0xFF;
+}
+
+uint16_t eeprom_read_word(const uint16_t *address) {
+  uint16_t value;
+  eeprom_read_block(&value, address, sizeof(value));
+  return value;
+}
+
+void eeprom_read_block(void *destination, const void *source, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    ((uint8_t *)destination)[i] = eeprom_read_byte((const uint8_t *)source + i);
+  }
+}
+
+void eeprom_write_byte(uint8_t *address, uint8_t value) {
+  size_t index = cell(address);
+  if (index <= E2END) {
+    cells[index] = value;
+  }
+}
+
+void eeprom_update_byte(uint8_t *address, uint8_t value) {
+  eeprom_write_byte(address, value);
+}
+
+void eeprom_update_word(uint16_t *address, uint16_t value) {
+  eeprom_update_block(&value, address, sizeof(value));
+}
+
+void eeprom_write_block(const void *source, void *destination, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    eeprom_write_byte((uint8_t *)destination + i, ((const uint8_t *)source)[i]);
+  }
+}
+
+void eeprom_update_block(const void *source, void *destination, size_t size) {
+  eeprom_write_block(source, destination, size);
+}
+
+//function to fill the EEPROM from a file written by simEepromSave(), a missing file leaves it erased
+void simEepromLoad(const char *path) {
+  cell(0);
+  FILE *file = fopen(path, "rb");
+  if (file) {
+    if (fread(cells, 1, sizeof(cells), file) != sizeof(cells)) {
+      fprintf(stderr, "%s: short EEPROM image\n", path);
+    }
+    fclose(file);
+  }
+}
+
+//function to write the EEPROM out to a file
+void simEepromSave(const char *path) {
+  cell(0);
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    perror(path);
+    return;
+  }
+  fwrite(cells, 1, sizeof(cells), file);
+  fclose(file);
+}
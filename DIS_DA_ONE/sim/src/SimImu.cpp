@@ -0,0 +1,244 @@
+/*
+  SimImu.cpp
+  Kyzer Bowen, Tyce Miller
+
+  TWI bus and MPU6050 of the native build, see Sim.h.
+  The TWI is modeled at its registers: each command written to TWCR (START, address, data byte, STOP) takes its
+  time on the bus at the clock set in TWBR, then TWSR gets the status the ATmega2560 would show and TWINT sets, so
+  the state machine in Twi.cpp walks through the same cases as on the robot. STOP finishes at once.
+  The MPU6050 behind it has the registers Imu.cpp uses. Once awake it samples at 1 kHz (8 kHz with the low pass
+  off) / (1 + SMPLRT_DIV), pushes the enabled sensors into its FIFO and pulses INT when data ready is enabled.
+  Samples are at rest apart from the yaw rate, which is the turn rate of the simulated robot plus simRobot.gyroBias.
+  MPU6050 register map: https://invensense.tdk.com/wp-content/uploads/2015/02/MPU-6000-Register-Map1.pdf
+*/
+
+#include <math.h>
+#include <deque>
+#include "Sim.h"
+#include <Arduino.h>
+#include <util/twi.h>
+#include "RobotConfig.h"
+#include "Imu.h"
+
+//MPU6050 registers
+#define MPU_SMPLRT_DIV 0x19
+#define MPU_CONFIG 0x1A
+#define MPU_GYRO_CONFIG 0x1B
+#define MPU_ACCEL_CONFIG 0x1C
+#define MPU_FIFO_EN 0x23
+#define MPU_INT_ENABLE 0x38
+#define MPU_ACCEL_XOUT_H 0x3B
+#define MPU_USER_CTRL 0x6A
+#define MPU_PWR_MGMT_1 0x6B
+#define MPU_FIFO_COUNTH 0x72
+#define MPU_FIFO_COUNTL 0x73
+#define MPU_FIFO_R_W 0x74
+#define MPU_WHO_AM_I 0x75
+
+#define MPU_FIFO_SIZE 1024
+#define ROOM_TEMPERATURE 25.0   //degrees C
+
+volatile uint8_t TWBR;
+volatile uint8_t TWSR;
+volatile uint8_t TWDR;
+
+static bool busOwned = false;     //START sent and no STOP yet
+static bool addressNext = false;  //the next byte is the address after a START
+static bool reading = false;      //the device was addressed for a read
+static bool registerNext = false; //the next byte written is the register pointer
+static uint8_t status;            //TWSR once the command is done
+static uint8_t pointer;           //MPU6050 register pointer
+
+static uint8_t regs[128];                  //MPU6050 registers
+static std::deque<uint8_t> fifo;           //MPU6050 FIFO
+static double lastHeading = 0;             //true heading at the last sample, degrees
+
+static void commandDone();
+static void takeSample();
+static SimEvent twiEvent = {0, commandDone, false};
+static SimEvent sampleEvent = {0, takeSample, false};
+
+//function to return the cycles one bit takes on the bus, SCL = F_CPU / (16 + 2 * TWBR * 4^prescaler)
+static SimTime bitTime() {
+  static const SimTime prescale[4] = {1, 4, 16, 64};
+  return 16 + 2 * TWBR * prescale[TWSR & 0x03];
+}
+
+//function to return the cycles between MPU6050 samples
+static SimTime samplePeriod() {
+  uint8_t lowPass = regs[MPU_CONFIG] & 0x07;
+  SimTime rate = (lowPass == 0 || lowPass == 7) ? 8000 : 1000;
+  return SIM_CPU_HZ * (1 + regs[MPU_SMPLRT_DIV]) / rate;
+}
+
+static bool awake() {
+  return !(regs[MPU_PWR_MGMT_1] & 0x40);
+}
+
+//function to put the MPU6050 in its power on state, asleep
+static void mpuReset() {
+  memset(regs, 0, sizeof(regs));
+  regs[MPU_PWR_MGMT_1] = 0x40;
+  regs[MPU_WHO_AM_I] = MPU_ADDRESS;
+  fifo.clear();
+  simCancel(sampleEvent);
+}
+
+//function to write one MPU6050 register
+static void mpuWrite(uint8_t reg, uint8_t value) {
+  if (reg == MPU_PWR_MGMT_1 && (value & 0x80)) {
+    mpuReset();
+    return;
+  }
+  if (reg == MPU_WHO_AM_I) {
+    return;   //read only
+  }
+  if (reg == MPU_USER_CTRL && (value & 0x04)) {
+    fifo.clear();
+    value &= ~0x04;   //FIFO_RESET clears itself
+  }
+  regs[reg & 0x7F] = value;
+  if (awake() && !sampleEvent.armed) {
+    double x, y;
+    simRobotPose(&x, &y, &lastHeading);
+    simSchedule(sampleEvent, simNow + samplePeriod());
+  }
+}
+
+//function to read one MPU6050 register, FIFO_R_W pops the FIFO
+static uint8_t mpuRead(uint8_t reg) {
+  switch (reg) {
+    case MPU_FIFO_COUNTH:
+      return fifo.size() >> 8;
+    case MPU_FIFO_COUNTL:
+      return fifo.size() & 0xFF;
+    case MPU_FIFO_R_W: {
+      if (fifo.empty()) {
+        return 0;
+      }
+      uint8_t byte = fifo.front();
+      fifo.pop_front();
+      return byte;
+    }
+    default:
+      return regs[reg & 0x7F];
+  }
+}
+
+//function to store one big endian sample word in the data registers
+static void putWord(uint8_t reg, double value) {
+  long word = lround(value);
+  word = word > 32767 ? 32767 : (word < -32768 ? -32768 : word);
+  regs[reg] = (uint16_t)word >> 8;
+  regs[reg + 1] = word & 0xFF;
+}
+
+//sample event: new accel, temperature and gyro values, into the FIFO in register order and a data ready pulse
+static void takeSample() {
+  if (!awake()) {
+    return;
+  }
+  double x, y, heading;
+  simRobotPose(&x, &y, &heading);
+  double seconds = (double)samplePeriod() / SIM_CPU_HZ;
+  double yawRate = remainder(heading - lastHeading, 360.0) / seconds + simRobot.gyroBias;
+  lastHeading = heading;
+
+  double accelLsb = 16384.0 / (1 << ((regs[MPU_ACCEL_CONFIG] >> 3) & 0x03));
+  double gyroLsb = 131.0 / (1 << ((regs[MPU_GYRO_CONFIG] >> 3) & 0x03));
+  putWord(MPU_ACCEL_XOUT_H, 0);
+  putWord(MPU_ACCEL_XOUT_H + 2, 0);
+  putWord(MPU_ACCEL_XOUT_H + 4, accelLsb);                            //flat on the floor, 1 g up
+  putWord(MPU_ACCEL_XOUT_H + 6, (ROOM_TEMPERATURE - 36.53) * 340.0);
+  putWord(MPU_ACCEL_XOUT_H + 8, 0);
+  putWord(MPU_ACCEL_XOUT_H + 10, 0);
+  putWord(MPU_ACCEL_XOUT_H + 12, yawRate * gyroLsb);
+
+  if (regs[MPU_USER_CTRL] & 0x40) {
+    static const uint8_t enableBit[7] = {0x08, 0x08, 0x08, 0x80, 0x40, 0x20, 0x10};   //FIFO_EN bit of each word
+    for (uint8_t i = 0; i < 7; i++) {
+      if (regs[MPU_FIFO_EN] & enableBit[i]) {
+        for (uint8_t j = 0; j < 2; j++) {
+          if (fifo.size() == MPU_FIFO_SIZE) {
+            fifo.pop_front();   //full, the oldest byte is overwritten
+          }
+          fifo.push_back(regs[MPU_ACCEL_XOUT_H + 2 * i + j]);
+        }
+      }
+    }
+  }
+  if (regs[MPU_INT_ENABLE] & 0x01) {
+    simRaisePin(imuIntPin, true);
+  }
+  simSchedule(sampleEvent, simNow + samplePeriod());
+}
+
+//TWI event: the command on the bus is done, status in TWSR and TWINT set
+static void commandDone() {
+  TWSR = status | (TWSR & 0x03);
+  TWCR.value |= _BV(TWINT);
+  simRaise(SIM_TWI);
+}
+
+//function to act on a TWCR write, writing TWINT as 1 starts the next bus action
+static void writeTwcr(uint8_t before, uint8_t after) {
+  if (!(after & _BV(TWEN))) {
+    busOwned = false;
+    simCancel(twiEvent);
+    return;
+  }
+  if (!(after & _BV(TWINT))) {
+    TWCR.value = (after & ~_BV(TWINT)) | (before & _BV(TWINT));   //writing 0 leaves the flag alone
+    return;
+  }
+  TWCR.value = after & ~_BV(TWINT);
+
+  SimTime time = 9 * bitTime();   //a byte and its ACK
+  if (after & _BV(TWSTO)) {
+    busOwned = false;
+    TWCR.value &= ~_BV(TWSTO);   //STOP is done by the time anyone looks
+    return;
+  }
+  if (after & _BV(TWSTA)) {
+    status = busOwned ? TW_REP_START : TW_START;
+    busOwned = true;
+    addressNext = true;
+    time = bitTime();
+  } else if (!busOwned) {
+    return;
+  } else if (addressNext) {
+    uint8_t address = TWDR;
+    bool ack = simRobot.imuPresent && (address >> 1) == MPU_ADDRESS;
+    reading = address & TW_READ;
+    registerNext = !reading;
+    addressNext = false;
+    if (reading) {
+      status = ack ? TW_MR_SLA_ACK : TW_MR_SLA_NACK;
+    } else {
+      status = ack ? TW_MT_SLA_ACK : TW_MT_SLA_NACK;
+    }
+  } else if (!reading) {
+    if (registerNext) {
+      pointer = TWDR;
+      registerNext = false;
+    } else {
+      mpuWrite(pointer, TWDR);
+      pointer = (pointer + 1) & 0x7F;
+    }
+    status = TW_MT_DATA_ACK;
+  } else {
+    TWDR = mpuRead(pointer);
+    if (pointer != MPU_FIFO_R_W) {
+      pointer = (pointer + 1) & 0x7F;   //burst reads of the FIFO stay on the FIFO
+    }
+    status = (after & _BV(TWEA)) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+  }
+  simSchedule(twiEvent, simNow + time);
+}
+
+SimReg8 TWCR(0, writeTwcr);
+
+//function to power the MPU6050 up, asleep like after a power on reset
+void simImuBegin() {
+  mpuReset();
+}
@@ -0,0 +1,239 @@
+/*
+  SimMain.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Drive simulator of the native build, see Sim.h.
+  Runs the firmware's setup() and then loop() over and over against the simulated robot, feeding it the commands of a
+  script one at a time. After each command has finished (queue empty and wheels stopped) the true pose of the robot is
+  printed next to the pose odometry.cpp thinks it is at, so a change to the motion code can be checked on a desk.
+
+  Usage: .pio/build/native/program [-f script] [--wheel cm] [--track cm] [--gyro-bias deg/s] [--no-imu]
+                                   [--slip-right %] [--slip-left %]
+                                   [--trace file.csv] [--timeout s] [--eeprom file] [--quiet]
+  --eeprom reads the EEPROM from the file before setup() and writes it back at the end (calsave; survives a rerun).
+
+  Script lines (the script is read from stdin without -f, # starts a comment)
+  forward 30;              - any command of the command table, typed into the serial monitor
+  bt spin 1 90;            - the same, sent over the HC-05
+  wait 500                 - let the firmware run for 500 ms more
+  expect 30 0 0 1.5        - fail unless the true pose is within 1.5 cm (x, y) and 1.5 degrees (heading)
+  report                   - print the true and odometry pose
+
+  The primary functions created are
+  main - parse the options, run setup() and the script, print the speedup of the sim over the real robot
+  runUntil - run loop() until a condition holds or the timeout passes
+  report - print the true and estimated pose
+
+  Key variables
+  trace - CSV of both poses every TRACE_PERIOD_US of simulated time, for plotting
+*/
+
+#include <stdio.h>
+#include <time.h>
+#include "Sim.h"
+#include <Arduino.h>
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include "MotionQueue.h"
+#include "Odometry.h"
+#include "Bluetooth.h"
+
+#define TRACE_PERIOD_US 10000UL   //simulated time between trace rows
+#define LINE_LENGTH 128
+
+void setup();
+void loop();
+
+static FILE *trace = 0;               //CSV of the poses, 0 when not tracing
+static SimTime nextTrace = 0;         //cycle of the next trace row
+static SimTime timeout = 0;           //cycles a single script line may take, 0 for no limit
+static bool timedOut = false;
+
+//function to write a trace row when one is due
+static void traceRow() {
+  if (!trace || simNow < nextTrace) {
+    return;
+  }
+  nextTrace = simNow + SIM_US(TRACE_PERIOD_US);
+  double x, y, heading;
+  simRobotPose(&x, &y, &heading);
+  Pose estimate = odometry.pose();
+  fprintf(trace, "%.4f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%ld,%ld\n", (double)simNow / SIM_CPU_HZ, x, y, heading,
+          (double)estimate.x / FIX_ONE, (double)estimate.y / FIX_ONE, (double)estimate.heading / FIX_ONE,
+          simRobotSteps(RIGHT), simRobotSteps(LEFT));
+}
+
+//function to tell the last command has finished, bytes still in the Bluetooth receive buffer wait for the comms task
+static bool idle() {
+  return !simSerialPending() && !simBluetoothPending() && !bluetooth.available() && !motionQueue.busy() &&
+         !stepEngine.isRunning();
+}
+
+//function to run loop() until done() is true, false if the timeout passed first
+static bool runUntil(bool (*done)(), SimTime limit) {
+  SimTime start = simNow;
+  while (!done()) {
+    if (limit && simNow - start > limit) {
+      return false;
+    }
+    loop();
+    traceRow();
+  }
+  return true;
+}
+
+static SimTime waitEnd;
+static bool waited() {
+  return simNow >= waitEnd;
+}
+
+//function to print the true pose and the odometry pose
+static void report(const char *label) {
+  double x, y, heading;
+  simRobotPose(&x, &y, &heading);
+  Pose estimate = odometry.pose();
+  printf("[%9.3f s] %-24s true %8.2f %8.2f %8.2f   odometry %8.2f %8.2f %8.2f\n", (double)simNow / SIM_CPU_HZ,
+         label, x, y, heading, (double)estimate.x / FIX_ONE, (double)estimate.y / FIX_ONE,
+         (double)estimate.heading / FIX_ONE);
+}
+
+//function to check the true pose against an expected one, the heading error wraps around
+static bool expect(double x, double y, double heading, double tolerance) {
+  double trueX, trueY, trueHeading;
+  simRobotPose(&trueX, &trueY, &trueHeading);
+  double headingError = remainder(trueHeading - heading, 360.0);
+  bool good = fabs(trueX - x) <= tolerance && fabs(trueY - y) <= tolerance && fabs(headingError) <= tolerance;
+  printf("expect %.2f %.2f %.2f: %s\n", x, y, heading, good ? "ok" : "FAILED");
+  return good;
+}
+
+//function to run one script line, false if it failed
+static bool runLine(char *line, bool quiet) {
+  char *comment = strchr(line, '#');
+  if (comment) {
+    *comment = 0;
+  }
+  char *start = line + strspn(line, " \t\r\n");
+  char *end = start + strlen(start);
+  while (end > start && strchr(" \t\r\n", end[-1])) {
+    *--end = 0;
+  }
+  if (!*start) {
+    return true;
+  }
+
+  double x, y, heading, tolerance;
+  unsigned long ms;
+  if (sscanf(start, "wait %lu", &ms) == 1) {
+    waitEnd = simNow + SIM_US(ms * 1000.0);
+    runUntil(waited, 0);
+    return true;
+  }
+  if (sscanf(start, "expect %lf %lf %lf %lf", &x, &y, &heading, &tolerance) == 4) {
+    return expect(x, y, heading, tolerance);
+  }
+  if (!strcmp(start, "report")) {
+    report("");
+    return true;
+  }
+
+  if (!strncmp(start, "bt ", 3)) {
+    simBluetoothInput(start + 3);
+    simBluetoothInput("\n");
+  } else {
+    simSerialInput(start);
+    simSerialInput("\n");
+  }
+  if (!runUntil(idle, timeout)) {
+    printf("timed out: %s\n", start);
+    timedOut = true;
+    return false;
+  }
+  if (!quiet) {
+    report(start);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  FILE *script = stdin;
+  bool quiet = false;
+  const char *eeprom = 0;
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : 0;
+    if (!strcmp(option, "--quiet")) {
+      quiet = true;
+    } else if (!strcmp(option, "--no-imu")) {
+      simRobot.imuPresent = false;
+    } else if (!value) {
+      fprintf(stderr, "%s needs a value\n", option);
+      return 2;
+    } else if (!strcmp(option, "-f")) {
+      script = fopen(value, "r");
+      if (!script) {
+        perror(value);
+        return 2;
+      }
+      i++;
+    } else if (!strcmp(option, "--wheel")) {
+      simRobot.wheelDiam = atof(value);
+      i++;
+    } else if (!strcmp(option, "--track")) {
+      simRobot.trackWidth = atof(value);
+      i++;
+    } else if (!strcmp(option, "--slip-right")) {
+      simRobot.slip[RIGHT] = atof(value) / 100;
+      i++;
+    } else if (!strcmp(option, "--slip-left")) {
+      simRobot.slip[LEFT] = atof(value) / 100;
+      i++;
+    } else if (!strcmp(option, "--gyro-bias")) {
+      simRobot.gyroBias = atof(value);
+      i++;
+    } else if (!strcmp(option, "--eeprom")) {
+      eeprom = value;
+      simEepromLoad(eeprom);
+      i++;
+    } else if (!strcmp(option, "--timeout")) {
+      timeout = SIM_US(atof(value) * 1000000.0);
+      i++;
+    } else if (!strcmp(option, "--trace")) {
+      trace = fopen(value, "w");
+      if (!trace) {
+        perror(value);
+        return 2;
+      }
+      fprintf(trace, "time,x,y,heading,odom_x,odom_y,odom_heading,right_steps,left_steps\n");
+      i++;
+    } else {
+      fprintf(stderr, "unknown option %s\n", option);
+      return 2;
+    }
+  }
+  simSerialEcho(!quiet);
+
+  clock_t wallStart = clock();
+  simRobotBegin();
+  simImuBegin();
+  sei();
+  setup();
+
+  bool good = true;
+  char line[LINE_LENGTH];
+  while (!timedOut && fgets(line, sizeof(line), script)) {
+    good = runLine(line, quiet) && good;
+  }
+  report("end");
+
+  double wall = (double)(clock() - wallStart) / CLOCKS_PER_SEC;
+  double simulated = (double)simNow / SIM_CPU_HZ;
+  printf("%.3f s simulated in %.3f s, %.0fx real time\n", simulated, wall, wall > 0 ? simulated / wall : 0.0);
+  if (trace) {
+    fclose(trace);
+  }
+  if (eeprom) {
+    simEepromSave(eeprom);
+  }
+  return good ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/*
+  SimRobot.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Differential drive model of the native build, see Sim.h.
+  PORTB is watched for step pulses: every rising edge on a step pin (with the stepper driver enabled) turns that
+  wheel one step in the direction its DIR pin gives, and the robot moves along the arc that wheel makes about the
+  other one. The encoder slots are counted off the same wheel travel, ticksPerRev edges per turn on the encoder's
+  interrupt pin, so the encoder ISRs in Encoders.cpp see what the steps really did.
+  The true geometry is simRobot, which starts out as RobotConfig.h and can be set apart from it to see how the
+  firmware copes with a robot that does not match its constants.
+
+  Pose - x, y in cm, heading in radians counterclockwise from the x axis, the right wheel moving forward turns the
+  robot counterclockwise
+*/
+
+#include <math.h>
+#include "Sim.h"
+#include <Arduino.h>
+#include "RobotConfig.h"
+#include "StepDriver.h"
+
+#define STEPS_PER_EDGE (stepsPerRev / ticksPerRev)   //wheel steps between encoder edges
+
+SimRobotModel simRobot = {wheelDiam, robotDiam, 0.0, true, {0.0, 0.0}};
+
+static double poseX = 0;         //cm
+static double poseY = 0;         //cm
+static double heading = 0;       //radians
+static long wheelSteps[2];       //steps each wheel has turned, indexed by RIGHT and LEFT
+static long encoderEdge[2];      //encoder slot edge each wheel is on
+
+static void writePortb(uint8_t before, uint8_t after) {
+  uint8_t rising = after & ~before;
+  if (rising & RT_STEP_BIT) {
+    simRobotStep(RIGHT, (after & RT_DIR_BIT) ? 1 : -1);
+  }
+  if (rising & LT_STEP_BIT) {
+    simRobotStep(LEFT, (after & LT_DIR_BIT) ? 1 : -1);
+  }
+}
+
+SimReg8 PORTB(0, writePortb);
+volatile uint8_t DDRB;
+volatile uint8_t PINB;
+
+//function to put the robot back at (0, 0) facing along x
+void simRobotBegin() {
+  poseX = 0;
+  poseY = 0;
+  heading = 0;
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    wheelSteps[wheel] = 0;
+    encoderEdge[wheel] = 0;
+  }
+}
+
+//function to turn a wheel one step, moves the robot and puts an edge on the encoder pin when a slot edge goes by
+void simRobotStep(uint8_t wheel, int8_t dir) {
+  if (digitalRead(stepperEnable) != (stepperEnTrue ? HIGH : LOW)) {
+    return;   //driver off, the step pulse does nothing
+  }
+  wheelSteps[wheel] += dir;
+
+  double distance = dir * simRobot.wheelDiam * PI / stepsPerRev * (1 - simRobot.slip[wheel]);   //cm the wheel rolls
+  double turn = (wheel == RIGHT ? distance : -distance) / simRobot.trackWidth;
+  double middle = heading + turn / 2;
+  poseX += distance / 2 * cos(middle);   //the center moves half as far as the wheel
+  poseY += distance / 2 * sin(middle);
+  heading += turn;
+
+  long shifted = wheelSteps[wheel] + STEPS_PER_EDGE / 2;   //edges sit half way between slot counts
+  long edge = shifted >= 0 ? shifted / STEPS_PER_EDGE : -((STEPS_PER_EDGE - 1 - shifted) / STEPS_PER_EDGE);
+  if (edge != encoderEdge[wheel]) {
+    encoderEdge[wheel] = edge;
+    simRaisePin(wheel == RIGHT ? rtEncoder : ltEncoder, edge & 1);
+  }
+}
+
+//function to return the true pose, heading in degrees from -180 to 180
+void simRobotPose(double *x, double *y, double *degrees) {
+  *x = poseX;
+  *y = poseY;
+  *degrees = remainder(heading * RAD_TO_DEG, 360.0);
+}
+
+//function to return the steps a wheel has really turned
+long simRobotSteps(uint8_t wheel) {
+  return wheelSteps[wheel];
+}
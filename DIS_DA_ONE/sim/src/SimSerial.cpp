@@ -0,0 +1,281 @@
+/*
+  SimSerial.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Serial ports of the native build, see Sim.h.
+  Serial is the serial monitor: what the firmware prints goes straight to stdout and what the script types is there
+  to read right away. USART2 is modeled at its registers for the interrupt driven HC-05 link in Bluetooth.cpp:
+  received bytes arrive one byte time apart at the baud rate set in UBRR2, and the transmitter is always ready, so
+  the data register empty interrupt sends a byte as soon as it is turned on. Bytes sent to the HC-05 are printed
+  one line at a time after "bt> ".
+*/
+
+#include <stdio.h>
+#include <deque>
+#include "Sim.h"
+#include <Arduino.h>
+
+HardwareSerial Serial;
+
+static std::deque<uint8_t> serialIn;       //typed into the serial monitor, not read yet
+static std::deque<uint8_t> bluetoothIn;    //sent by the phone, not received yet
+static bool echo = true;                   //print what the firmware sends
+static uint8_t rxData;                     //byte waiting in UDR2
+static bool rxFull = false;                //UDR2 holds a byte the RX interrupt has not read
+static bool overrun = false;               //a byte arrived before the last one was read
+static char btLine[128];                   //HC-05 output waiting for its line ending
+static size_t btLength = 0;
+
+volatile uint8_t UCSR2C;
+volatile uint16_t UBRR2;
+
+static uint8_t readUcsr2a(uint8_t value) {
+  return (value & _BV(U2X2)) | _BV(UDRE2) | _BV(TXC2) | (rxFull ? _BV(RXC2) : 0) | (overrun ? _BV(DOR2) : 0);
+}
+
+static void writeUcsr2b(uint8_t before, uint8_t after);
+
+static uint8_t readUdr2(uint8_t value) {
+  rxFull = false;   //reading the byte clears the receive interrupt
+  overrun = false;
+  return rxData;
+}
+
+//function to take one byte the firmware sent to the HC-05
+static void writeUdr2(uint8_t before, uint8_t byte) {
+  if (byte == '\n' || btLength == sizeof(btLine) - 1) {
+    btLine[btLength] = 0;
+    if (echo) {
+      printf("bt> %s\n", btLine);
+    }
+    btLength = 0;
+  } else if (byte != '\r') {
+    btLine[btLength++] = byte;
+  }
+}
+
+SimReg8 UCSR2A(readUcsr2a, 0);
+SimReg8 UCSR2B(0, writeUcsr2b);
+SimReg8 UDR2(readUdr2, writeUdr2);
+
+//function to return the time of one byte (start, 8 data bits, stop) at the baud rate in UBRR2
+static SimTime byteTime() {
+  SimTime divider = (UCSR2A.value & _BV(U2X2)) ? 8 : 16;
+  return 10 * divider * (UBRR2 + 1);
+}
+
+static void receiveByte();
+static SimEvent rxEvent = {0, receiveByte, false};   //next byte comes off the HC-05
+
+//function to move the next byte from the HC-05 into UDR2
+static void receiveByte() {
+  if (bluetoothIn.empty() || !(UCSR2B.value & _BV(RXEN2))) {
+    return;
+  }
+  if (rxFull) {
+    overrun = true;   //the last byte was never read, this one is lost
+  } else {
+    rxData = bluetoothIn.front();
+    rxFull = true;
+  }
+  bluetoothIn.pop_front();
+  if (!bluetoothIn.empty()) {
+    simSchedule(rxEvent, simNow + byteTime());
+  }
+}
+
+static void writeUcsr2b(uint8_t before, uint8_t after) {
+  if ((after & _BV(RXEN2)) && !bluetoothIn.empty() && !rxEvent.armed) {
+    simSchedule(rxEvent, simNow + byteTime());
+  }
+  simDeliver();   //a data register empty interrupt turned on runs right away
+}
+
+bool simUsartRxWaiting() {
+  return rxFull;
+}
+
+void simSerialInput(const char *text) {
+  while (*text) {
+    serialIn.push_back(*text++);
+  }
+}
+
+bool simSerialPending() {
+  return !serialIn.empty();
+}
+
+void simBluetoothInput(const char *text) {
+  while (*text) {
+    bluetoothIn.push_back(*text++);
+  }
+  if ((UCSR2B.value & _BV(RXEN2)) && !rxEvent.armed) {
+    simSchedule(rxEvent, simNow + byteTime());
+  }
+}
+
+//function to tell if bytes are still on their way to the firmware over the HC-05
+bool simBluetoothPending() {
+  return !bluetoothIn.empty() || rxFull;
+}
+
+void simSerialEcho(bool on) {
+  echo = on;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+}
+
+void HardwareSerial::end() {
+}
+
+int HardwareSerial::available() {
+  return serialIn.size();
+}
+
+int HardwareSerial::read() {
+  if (serialIn.empty()) {
+    return -1;
+  }
+  uint8_t byte = serialIn.front();
+  serialIn.pop_front();
+  return byte;
+}
+
+int HardwareSerial::peek() {
+  return serialIn.empty() ? -1 : serialIn.front();
+}
+
+size_t HardwareSerial::write(uint8_t byte) {
+  if (echo && byte != '\r') {
+    putchar(byte);
+  }
+  return 1;
+}
+
+//function to return the room in the transmit buffer, always empty since the sim sends each byte as it comes
+int HardwareSerial::availableForWrite() {
+  return 63;
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+HardwareSerial::operator bool() {
+  return true;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+  while (size--) {
+    written += write(*buffer++);
+  }
+  return written;
+}
+
+size_t Print::write(const char *text) {
+  return write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::write(const char *buffer, size_t size) {
+  return write((const uint8_t *)buffer, size);
+}
+
+size_t Print::printNumber(unsigned long value, int base) {
+  char digits[8 * sizeof(long) + 1];
+  char *end = &digits[sizeof(digits) - 1];
+  *end = 0;
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    int digit = value % base;
+    *--end = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value);
+  return write(end);
+}
+
+size_t Print::print(const char *text) {
+  return write(text);
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base) {
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(long value, int base) {
+  if (base == 10 && value < 0) {
+    return print('-') + printNumber(-(unsigned long)value, 10);
+  }
+  return printNumber(value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return printNumber(value, base);
+}
+
+//function to print a number with a fixed number of decimals, like the core's printFloat()
+size_t Print::print(double value, int digits) {
+  if (isnan(value)) {
+    return print("nan");
+  }
+  if (isinf(value)) {
+    return print("inf");
+  }
+  if (value > 4294967040.0 || value < -4294967040.0) {
+    return print("ovf");
+  }
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return print(text);
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+size_t Print::println(const char *text) {
+  return print(text) + println();
+}
+
+size_t Print::println(char c) {
+  return print(c) + println();
+}
+
+size_t Print::println(unsigned char value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(double value, int digits) {
+  return print(value, digits) + println();
+}
@@ -0,0 +1,253 @@
+/*
+  SimSteppers.cpp
+  Kyzer Bowen, Tyce Miller
+
+  AccelStepper and MultiStepper mocks of the native build, see AccelStepper.h. The ramp follows the library's
+  computeNewSpeed() (David Austin's step interval recurrence) so the demos in main.cpp move the simulated robot the
+  way the library moves the real one.
+  http://www.airspayce.com/mikem/arduino/AccelStepper/
+*/
+
+#include <AccelStepper.h>
+#include <MultiStepper.h>
+
+AccelStepper::AccelStepper(void (*forward)(), void (*backward)())
+  : forward(forward), backward(backward), clockwise(false), currentPos(0), targetPos(0), speedNow(0), maxSpeedSet(0),
+    acceleration(0), stepInterval(0), lastStepTime(0), n(0), c0(0), cn(0), cmin(1) {
+  setAcceleration(1);
+  setMaxSpeed(1);
+}
+
+void AccelStepper::moveTo(long absolute) {
+  if (targetPos != absolute) {
+    targetPos = absolute;
+    computeNewSpeed();
+  }
+}
+
+void AccelStepper::move(long relative) {
+  moveTo(currentPos + relative);
+}
+
+//function to make a step if one is due at the current speed
+boolean AccelStepper::runSpeed() {
+  if (!stepInterval) {
+    return false;
+  }
+  unsigned long time = micros();
+  if (time - lastStepTime < stepInterval) {
+    return false;
+  }
+  currentPos += clockwise ? 1 : -1;
+  step();
+  lastStepTime = time;
+  return true;
+}
+
+boolean AccelStepper::run() {
+  if (runSpeed()) {
+    computeNewSpeed();
+  }
+  return speedNow != 0.0 || distanceToGo() != 0;
+}
+
+//function to work out the interval to the next step, the library's ramp
+unsigned long AccelStepper::computeNewSpeed() {
+  long distanceTo = distanceToGo();
+  long stepsToStop = (long)((speedNow * speedNow) / (2.0 * acceleration));
+  if (distanceTo == 0 && stepsToStop <= 1) {
+    stepInterval = 0;
+    speedNow = 0.0;
+    n = 0;
+    return stepInterval;
+  }
+  if (distanceTo > 0) {
+    if (n > 0) {
+      if (stepsToStop >= distanceTo || !clockwise) {
+        n = -stepsToStop;   //start decelerating
+      }
+    } else if (n < 0) {
+      if (stepsToStop < distanceTo && clockwise) {
+        n = -n;             //start accelerating again
+      }
+    }
+  } else if (distanceTo < 0) {
+    if (n > 0) {
+      if (stepsToStop >= -distanceTo || clockwise) {
+        n = -stepsToStop;
+      }
+    } else if (n < 0) {
+      if (stepsToStop < -distanceTo && !clockwise) {
+        n = -n;
+      }
+    }
+  }
+  if (n == 0) {
+    cn = c0;   //first step from rest
+    clockwise = distanceTo > 0;
+  } else {
+    cn = cn - ((2.0 * cn) / ((4.0 * n) + 1));
+    cn = max(cn, cmin);
+  }
+  n++;
+  stepInterval = cn;
+  speedNow = 1000000.0 / cn;
+  if (!clockwise) {
+    speedNow = -speedNow;
+  }
+  return stepInterval;
+}
+
+void AccelStepper::setMaxSpeed(float speed) {
+  if (speed < 0.0) {
+    speed = -speed;
+  }
+  if (maxSpeedSet != speed) {
+    maxSpeedSet = speed;
+    cmin = 1000000.0 / speed;
+    if (n > 0) {
+      n = (long)((speedNow * speedNow) / (2.0 * acceleration));
+      computeNewSpeed();
+    }
+  }
+}
+
+float AccelStepper::maxSpeed() {
+  return maxSpeedSet;
+}
+
+void AccelStepper::setAcceleration(float accel) {
+  if (accel == 0.0) {
+    return;
+  }
+  if (accel < 0.0) {
+    accel = -accel;
+  }
+  if (acceleration != accel) {
+    n = acceleration ? n * (acceleration / accel) : 0;
+    c0 = 0.676 * sqrt(2.0 / accel) * 1000000.0;   //equation 15, with the 0.676 correction
+    acceleration = accel;
+    computeNewSpeed();
+  }
+}
+
+void AccelStepper::setSpeed(float speed) {
+  if (speed == speedNow) {
+    return;
+  }
+  speed = constrain(speed, -maxSpeedSet, maxSpeedSet);
+  if (speed == 0.0) {
+    stepInterval = 0;
+  } else {
+    stepInterval = fabs(1000000.0 / speed);
+    clockwise = speed > 0.0;
+  }
+  speedNow = speed;
+}
+
+float AccelStepper::speed() {
+  return speedNow;
+}
+
+long AccelStepper::distanceToGo() {
+  return targetPos - currentPos;
+}
+
+long AccelStepper::targetPosition() {
+  return targetPos;
+}
+
+long AccelStepper::currentPosition() {
+  return currentPos;
+}
+
+void AccelStepper::setCurrentPosition(long position) {
+  targetPos = currentPos = position;
+  n = 0;
+  stepInterval = 0;
+  speedNow = 0.0;
+}
+
+void AccelStepper::runToPosition() {
+  while (run()) {
+  }
+}
+
+boolean AccelStepper::runSpeedToPosition() {
+  if (targetPos == currentPos) {
+    return false;
+  }
+  clockwise = targetPos > currentPos;
+  return runSpeed();
+}
+
+void AccelStepper::runToNewPosition(long position) {
+  moveTo(position);
+  runToPosition();
+}
+
+void AccelStepper::stop() {
+  if (speedNow != 0.0) {
+    long stepsToStop = (long)((speedNow * speedNow) / (2.0 * acceleration)) + 1;
+    move(speedNow > 0 ? stepsToStop : -stepsToStop);
+  }
+}
+
+bool AccelStepper::isRunning() {
+  return !(speedNow == 0.0 && targetPos == currentPos);
+}
+
+//function to make one step through the FUNCTION interface callbacks
+void AccelStepper::step() {
+  if (speedNow > 0) {
+    forward();
+  } else {
+    backward();
+  }
+}
+
+MultiStepper::MultiStepper() : count(0) {
+}
+
+boolean MultiStepper::addStepper(AccelStepper &stepper) {
+  if (count >= MULTISTEPPER_MAX_STEPPERS) {
+    return false;
+  }
+  steppers[count++] = &stepper;
+  return true;
+}
+
+//function to set every stepper's target and the speed that gets it there with the slowest one
+void MultiStepper::moveTo(long absolute[]) {
+  float longestTime = 0.0;
+  for (uint8_t i = 0; i < count; i++) {
+    long distance = absolute[i] - steppers[i]->currentPosition();
+    float time = labs(distance) / steppers[i]->maxSpeed();
+    if (time > longestTime) {
+      longestTime = time;
+    }
+  }
+  if (longestTime > 0.0) {
+    for (uint8_t i = 0; i < count; i++) {
+      long distance = absolute[i] - steppers[i]->currentPosition();
+      steppers[i]->moveTo(absolute[i]);
+      steppers[i]->setSpeed(distance / longestTime);
+    }
+  }
+}
+
+boolean MultiStepper::run() {
+  boolean running = false;
+  for (uint8_t i = 0; i < count; i++) {
+    if (steppers[i]->distanceToGo() != 0) {
+      steppers[i]->runSpeed();
+      running = true;
+    }
+  }
+  return running;
+}
+
+void MultiStepper::runSpeedToPosition() {
+  while (run()) {
+  }
+}
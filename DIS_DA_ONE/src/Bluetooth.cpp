@@ -0,0 +1,151 @@
+/*
+  Bluetooth.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Interrupt driven USART2 for the HC-05, see Bluetooth.h.
+  Receive: the RX complete interrupt moves each byte into the receive ring, read() takes them out.
+  Transmit: write() drops bytes into the transmit ring and turns on the data register empty interrupt, which sends
+  one byte each time the USART is ready and turns itself off when the ring is empty.
+  Each ring has one writer and one reader, so only the 8 bit indexes are shared and no locking is needed.
+*/
+
+#include "Bluetooth.h"
+#include <util/atomic.h>
+
+#define RX_MASK (BT_RX_SIZE - 1)
+#define TX_MASK (BT_TX_SIZE - 1)
+
+static uint8_t rxRing[BT_RX_SIZE];
+static volatile uint8_t rxHead = 0;          //next slot the RX interrupt fills
+static volatile uint8_t rxTail = 0;          //next byte read() returns
+static uint8_t txRing[BT_TX_SIZE];
+static volatile uint8_t txHead = 0;          //next slot write() fills
+static volatile uint8_t txTail = 0;          //next byte the UDRE interrupt sends
+static volatile unsigned int overflows = 0;  //received bytes dropped, receive ring full
+static volatile unsigned int overruns = 0;   //received bytes lost in the USART itself
+static bool sent = false;                    //something has been written since begin(), flush() waits for it
+
+UsartStream bluetooth;
+
+//function to send the next byte of the transmit ring, or stop the interrupt when it is empty
+static inline void sendNext() {
+  uint8_t tail = txTail;
+  if (tail == txHead) {
+    UCSR2B &= ~_BV(UDRIE2);
+    return;
+  }
+  UDR2 = txRing[tail];
+  UCSR2A = (UCSR2A & _BV(U2X2)) | _BV(TXC2);   //clear transmit complete so flush() waits for this byte
+  txTail = (tail + 1) & TX_MASK;
+}
+
+ISR(USART2_RX_vect) {
+  uint8_t status = UCSR2A;
+  uint8_t byte = UDR2;   //reading UDR2 clears the interrupt, so read it even if the byte is dropped
+  if (status & _BV(DOR2)) {
+    overruns++;
+  }
+  uint8_t next = (rxHead + 1) & RX_MASK;
+  if (next == rxTail) {
+    overflows++;
+    return;
+  }
+  rxRing[rxHead] = byte;
+  rxHead = next;
+}
+
+ISR(USART2_UDRE_vect) {
+  sendNext();
+}
+
+//function to set the baud rate and turn on the USART, 8 data bits, no parity, 1 stop bit
+void UsartStream::begin(unsigned long baud) {
+  uint16_t setting = (F_CPU / 4 / baud - 1) / 2;   //double speed mode, half the baud rate error of normal mode
+  UCSR2A = _BV(U2X2);
+  UBRR2 = setting;
+  UCSR2C = _BV(UCSZ21) | _BV(UCSZ20);
+  UCSR2B = _BV(RXEN2) | _BV(TXEN2) | _BV(RXCIE2);
+  rxHead = rxTail = 0;
+  txHead = txTail = 0;
+  sent = false;
+}
+
+//function to return how many received bytes are waiting
+int UsartStream::available() {
+  return (rxHead - rxTail) & RX_MASK;
+}
+
+//function to return the next received byte, -1 when there is none
+int UsartStream::read() {
+  uint8_t tail = rxTail;
+  if (tail == rxHead) {
+    return -1;
+  }
+  uint8_t byte = rxRing[tail];
+  rxTail = (tail + 1) & RX_MASK;
+  return byte;
+}
+
+//function to look at the next received byte without taking it, -1 when there is none
+int UsartStream::peek() {
+  uint8_t tail = rxTail;
+  if (tail == rxHead) {
+    return -1;
+  }
+  return rxRing[tail];
+}
+
+/*
+  Puts one byte in the transmit ring. If the ring is full this waits for the interrupt to make room, like
+  Serial.write(). With interrupts off (called from an ISR) it sends bytes by polling instead of hanging.
+*/
+size_t UsartStream::write(uint8_t byte) {
+  uint8_t next = (txHead + 1) & TX_MASK;
+  while (next == txTail) {
+    if (!(SREG & _BV(SREG_I)) && (UCSR2A & _BV(UDRE2))) {
+      sendNext();
+    }
+  }
+  txRing[txHead] = byte;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    txHead = next;
+    UCSR2B |= _BV(UDRIE2);
+  }
+  sent = true;
+  return 1;
+}
+
+//function to return how many bytes can be written without waiting
+int UsartStream::availableForWrite() {
+  return (txTail - txHead - 1) & TX_MASK;
+}
+
+//function to wait until every byte written has left the USART
+void UsartStream::flush() {
+  if (!sent) {
+    return;
+  }
+  while (txHead != txTail || !(UCSR2A & _BV(TXC2))) {
+    if (!(SREG & _BV(SREG_I)) && (UCSR2A & _BV(UDRE2))) {
+      sendNext();
+    }
+  }
+}
+
+//function to return how many received bytes were dropped because nobody read them in time
+unsigned int UsartStream::rxOverflows() {
+  unsigned int count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = overflows;
+  }
+  return count;
+}
+
+//function to return how many received bytes the USART lost because its interrupt came too late
+unsigned int UsartStream::rxOverruns() {
+  unsigned int count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = overruns;
+  }
+  return count;
+}
@@ -0,0 +1,81 @@
+/*
+  Boot.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Stage bookkeeping of the staged startup, see Boot.h. The stages themselves are run by boot_service() in main.cpp.
+*/
+
+#include "Boot.h"
+#include <avr/io.h>
+
+BootSequence boot;
+
+static const char *const stageName[BOOT_STAGES] = {"steppers", "encoders", "comms", "imu"};
+static const char *const stateName[] = {"waiting", "running", "ready", "FAILED"};
+
+//function to take time zero and the reset cause, MCUSR is cleared so the next reset shows only its own cause
+void BootSequence::begin() {
+  resetCause = MCUSR;
+  MCUSR = 0;
+  startMs = millis();
+  for (uint8_t stage = 0; stage < BOOT_STAGES; stage++) {
+    states[stage] = BOOT_WAITING;
+    doneMs[stage] = 0;
+  }
+}
+
+//function to mark a stage started
+void BootSequence::start(BootStage stage) {
+  states[stage] = BOOT_RUNNING;
+}
+
+//function to mark a stage done and when
+void BootSequence::finish(BootStage stage, bool ok) {
+  states[stage] = ok ? BOOT_READY : BOOT_FAILED;
+  doneMs[stage] = elapsed();
+}
+
+//function to check every stage is ready or failed
+bool BootSequence::done() {
+  for (uint8_t stage = 0; stage < BOOT_STAGES; stage++) {
+    if (states[stage] < BOOT_READY) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//function to check the robot can take commands, the IMU is not needed for them
+bool BootSequence::commandsReady() {
+  return states[BOOT_STEPPERS] == BOOT_READY && states[BOOT_ENCODERS] == BOOT_READY &&
+         states[BOOT_COMMS] >= BOOT_READY && elapsed() >= BOOT_HOLD_MS;
+}
+
+//function to print each stage with its state and the ms after reset it finished, then the reset cause
+void BootSequence::print(Print &port) {
+  for (uint8_t stage = 0; stage < BOOT_STAGES; stage++) {
+    port.print(stageName[stage]);
+    port.print('\t');
+    port.print(stateName[states[stage]]);
+    if (states[stage] >= BOOT_READY) {
+      port.print('\t');
+      port.print(doneMs[stage]);
+      port.print(" ms");
+    }
+    port.println();
+  }
+  port.print("reset:");
+  if (resetCause & _BV(PORF)) {
+    port.print(" power on");
+  }
+  if (resetCause & _BV(EXTRF)) {
+    port.print(" external");
+  }
+  if (resetCause & _BV(BORF)) {
+    port.print(" brown-out");
+  }
+  if (resetCause & _BV(WDRF)) {
+    port.print(" watchdog");
+  }
+  port.println();
+}
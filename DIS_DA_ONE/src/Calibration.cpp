@@ -0,0 +1,157 @@
+/*
+  Calibration.cpp
+  Kyzer Bowen, Tyce Miller
+
+  EEPROM record and trial fits of the wheel geometry, see Calibration.h.
+  Run the straight trial before the spin trial, the track width fit uses the wheel circumference in use.
+*/
+
+#include "Calibration.h"
+#include "RobotConfig.h"
+#include "FixedKinematics.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+Calibration calibration;
+
+//function to work out the CRC of a record, every byte before the crc field
+static uint16_t record_crc(const CalibrationRecord &record) {
+  const uint8_t *bytes = (const uint8_t *)&record;
+  uint16_t crc = 0;
+  for (uint8_t i = 0; i < offsetof(CalibrationRecord, crc); i++) {
+    crc = _crc_xmodem_update(crc, bytes[i]);
+  }
+  return crc;
+}
+
+//function to check a value is within CALIBRATION_LIMIT of what RobotConfig.h says it should be
+static bool plausible(float value, float nominal) {
+  return value > nominal * (1 - CALIBRATION_LIMIT) && value < nominal * (1 + CALIBRATION_LIMIT);
+}
+
+//function to rebuild the conversion factors from the values in use
+void Calibration::apply() {
+  setDriveGeometry(circumference, trackWidth, ticksPerRotation);
+}
+
+/*
+  Reads the record at CALIBRATION_ADDRESS and uses it when the magic number and CRC match and every value is
+  plausible. Otherwise the RobotConfig.h values are used and false comes back (an erased EEPROM reads 0xFF).
+*/
+bool Calibration::load() {
+  CalibrationRecord record;
+  eeprom_read_block(&record, (const void *)CALIBRATION_ADDRESS, sizeof(record));
+  stored = record.magic == CALIBRATION_MAGIC && record.crc == record_crc(record) &&
+           plausible(record.circumference, wheelCirc) && plausible(record.trackWidth, robotDiam) &&
+           plausible(record.ticksPerRotation, ticksPerRev);
+  if (stored) {
+    circumference = record.circumference;
+    trackWidth = record.trackWidth;
+    ticksPerRotation = record.ticksPerRotation;
+  } else {
+    circumference = wheelCirc;
+    trackWidth = robotDiam;
+    ticksPerRotation = ticksPerRev;
+  }
+  straightSteps = 0;
+  spinSteps = 0;
+  apply();
+  return stored;
+}
+
+//function to write the values in use to EEPROM, eeprom_update_block() skips the bytes that are already right
+void Calibration::save() {
+  CalibrationRecord record;
+  memset(&record, 0, sizeof(record));   //padding bytes (none on the AVR) go into the CRC too
+  record.magic = CALIBRATION_MAGIC;
+  record.circumference = circumference;
+  record.trackWidth = trackWidth;
+  record.ticksPerRotation = ticksPerRotation;
+  record.crc = record_crc(record);
+  eeprom_update_block(&record, (void *)CALIBRATION_ADDRESS, sizeof(record));
+  stored = true;
+}
+
+//function to go back to the RobotConfig.h values and erase the magic number so the next boot does too
+void Calibration::reset() {
+  eeprom_update_word((uint16_t *)CALIBRATION_ADDRESS, 0xFFFF);
+  load();
+}
+
+/*
+  Fits the encoder ticks per wheel rotation from a straight run of the given steps on each wheel and the encoder
+  ticks each wheel counted (the steps say how many rotations the wheels made, 800 a rotation). The trial is kept for
+  fitDistance(). False when the run was too short or the fit is not plausible, nothing is changed then.
+*/
+bool Calibration::straightTrial(long steps, const long ticks[2]) {
+  if (steps < stepsPerRev) {
+    return false;
+  }
+  float fit = (labs(ticks[RIGHT]) + labs(ticks[LEFT])) / 2.0 * stepsPerRev / steps;
+  if (!plausible(fit, ticksPerRev)) {
+    return false;
+  }
+  ticksPerRotation = fit;
+  straightSteps = steps;
+  stored = false;
+  apply();
+  return true;
+}
+
+/*
+  Fits the wheel circumference from the distance in cm the last straight trial really covered, measured on the
+  floor. The encoders turn with the wheels, they can not see tire squash or wheel slip, so it has to be measured.
+*/
+bool Calibration::fitDistance(float cm) {
+  if (straightSteps == 0) {
+    return false;
+  }
+  float fit = cm * stepsPerRev / straightSteps;
+  if (!plausible(fit, wheelCirc)) {
+    return false;
+  }
+  circumference = fit;
+  stored = false;
+  apply();
+  return true;
+}
+
+//function to keep the steps of a spin trial without fitting anything, fitSpin(0, degrees) fits it once the angle is measured
+void Calibration::spinTrial(long steps) {
+  spinSteps = steps;
+}
+
+/*
+  Fits the track width from a spin in place of the given steps on each wheel and the degrees the robot turned (from
+  the gyro, or measured). Each wheel rolls along the spin circle, so its travel is the track width times half the
+  angle in radians. The trial is kept, fitSpin(0, degrees) refits it with a better angle.
+*/
+bool Calibration::fitSpin(long steps, float degrees) {
+  if (steps == 0) {
+    steps = spinSteps;
+  }
+  if (steps < stepsPerRev || degrees < 90) {
+    return false;
+  }
+  float travel = steps * circumference / stepsPerRev;
+  float fit = 2 * travel / (degrees * PI / 180);
+  if (!plausible(fit, robotDiam)) {
+    return false;
+  }
+  trackWidth = fit;
+  spinSteps = steps;
+  stored = false;
+  apply();
+  return true;
+}
+
+//function to print the values in use and where they came from
+void Calibration::print(Print &port) {
+  port.print("wheel: ");
+  port.print(circumference, 3);
+  port.print(" cm\ttrack: ");
+  port.print(trackWidth, 3);
+  port.print(" cm\tticks/rev: ");
+  port.print(ticksPerRotation, 2);
+  port.println(stored ? "\t(EEPROM)" : "\t(not saved)");
+}
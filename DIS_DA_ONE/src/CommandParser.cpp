@@ -0,0 +1,129 @@
+/*
+  CommandParser.cpp
+  Kyzer Bowen, Tyce Miller
+
+  One byte at a time command parser, see CommandParser.h.
+  Letters build the verb until the first space, digits build the current number, spaces and commas end it.
+  Upper case letters are folded to lower case so "FORWARD 10;" works from a phone keyboard.
+*/
+
+#include "CommandParser.h"
+
+//function to set the command table and start from a clean state
+void CommandParser::begin(const Command *table, uint8_t count) {
+  commands = table;
+  commandCount = count;
+  restart();
+}
+
+//function to forget the command in progress
+void CommandParser::restart() {
+  verbLength = 0;
+  verb[0] = 0;
+  argCount = 0;
+  inVerb = false;
+  inNumber = false;
+  negative = false;
+  bad = false;
+}
+
+//function to end the number being read, it only gets its sign once all its digits are in
+void CommandParser::endNumber() {
+  if (inNumber && negative) {
+    args[argCount - 1] = -args[argCount - 1];
+  }
+  inNumber = false;
+  negative = false;
+}
+
+//function to parse one byte, the command runs when its ';' comes in
+CommandResult CommandParser::feed(char c) {
+  if (c == ';') {
+    CommandResult result = finish();
+    restart();
+    return result;
+  }
+  if (bad) {
+    return COMMAND_NONE;
+  }
+
+  if (c >= 'A' && c <= 'Z') {
+    c += 'a' - 'A';
+  }
+  bool letter = c >= 'a' && c <= 'z';
+  bool digit = c >= '0' && c <= '9';
+  if (letter || (digit && inVerb)) {
+    //verb characters, a digit right after a letter is part of the verb ("fig8")
+    if ((verbLength > 0 && !inVerb) || verbLength >= COMMAND_VERB_SIZE - 1) {
+      bad = true;
+      return COMMAND_NONE;
+    }
+    verb[verbLength++] = c;
+    verb[verbLength] = 0;
+    inVerb = true;
+  } else if (digit) {
+    if (!inNumber) {
+      if (verbLength == 0 || argCount >= COMMAND_MAX_ARGS) {
+        bad = true;
+        return COMMAND_NONE;
+      }
+      args[argCount++] = 0;
+      inNumber = true;
+    }
+    int &value = args[argCount - 1];
+    if (value > (32767 - (c - '0')) / 10) {
+      bad = true;   //would not fit in an int
+      return COMMAND_NONE;
+    }
+    value = value * 10 + (c - '0');
+  } else if (c == '-' && !inNumber && !negative && verbLength > 0) {
+    negative = true;
+    inVerb = false;
+  } else if (c == ' ' || c == ',' || c == '\t' || c == '\r' || c == '\n') {
+    if (negative && !inNumber) {
+      bad = true;   //a '-' with no number after it
+      return COMMAND_NONE;
+    }
+    endNumber();
+    inVerb = false;
+  } else {
+    bad = true;
+  }
+  return COMMAND_NONE;
+}
+
+//function to look up the finished command and run it
+CommandResult CommandParser::finish() {
+  if (negative && !inNumber) {
+    bad = true;   //a '-' with no number after it
+  }
+  endNumber();
+  if (bad) {
+    return COMMAND_BAD;
+  }
+  if (verbLength == 0) {
+    return COMMAND_NONE;   //empty command, ";;" or just a line ending
+  }
+  for (uint8_t i = 0; i < commandCount; i++) {
+    if (strcmp(verb, commands[i].verb) == 0) {
+      if (argCount != commands[i].args) {
+        return COMMAND_BAD;
+      }
+      commands[i].run(args);
+      return COMMAND_DONE;
+    }
+  }
+  return COMMAND_UNKNOWN;
+}
+
+//function to feed the bytes waiting on a port up to the end of the first command, the rest stay for the next call
+CommandResult CommandParser::poll(Stream &port) {
+  int c;
+  while ((c = port.read()) >= 0) {
+    CommandResult result = feed((char)c);
+    if (result != COMMAND_NONE) {
+      return result;   //one result per call so each command gets its own answer
+    }
+  }
+  return COMMAND_NONE;
+}
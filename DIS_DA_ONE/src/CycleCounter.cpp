@@ -0,0 +1,45 @@
+/*
+  CycleCounter.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Timer5 cycle counter, see CycleCounter.h.
+*/
+
+#include "CycleCounter.h"
+#include <util/atomic.h>
+
+static volatile uint16_t wraps = 0;   //Timer5 overflows, the top half of cycleCount()
+static bool running = false;
+
+ISR(TIMER5_OVF_vect) {
+  wraps++;
+}
+
+//function to start Timer5 free running at the CPU clock, calling it again leaves the count running
+void cycleCounterBegin() {
+  if (running) {
+    return;
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    TCCR5A = 0;             //normal mode, output compare pins disconnected
+    TCCR5B = _BV(CS50);     //clk/1, one count per CPU cycle
+    TCNT5 = 0;
+    TIFR5 = _BV(TOV5);      //clear a stale overflow
+    TIMSK5 = _BV(TOIE5);
+  }
+  running = true;
+}
+
+//function to return the cycles since cycleCounterBegin()
+uint32_t cycleCount() {
+  uint16_t count;
+  uint16_t high;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = TCNT5;
+    high = wraps;
+    if ((TIFR5 & _BV(TOV5)) && count < 0x8000) {
+      high++;   //wrapped after interrupts went off, the overflow ISR has not counted it yet
+    }
+  }
+  return ((uint32_t)high << 16) | count;
+}
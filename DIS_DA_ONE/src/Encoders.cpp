@@ -0,0 +1,154 @@
+/*
+  Encoders.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Encoder interrupts and the period based speed estimate, see Encoders.h.
+  The encoders interrupt on both edges (CHANGE) and the slots are not exactly half of each slot pitch, so one tick
+  period alternates long and short. The speed uses the time across the last two ticks (one whole slot) to cancel
+  that out, and falls back to a single tick right after the wheel starts.
+*/
+
+#include "Encoders.h"
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include "Profiler.h"
+#include "Probes.h"
+#include <util/atomic.h>
+
+#define RING_MASK (ENCODER_RING_SIZE - 1)
+
+//time stamps from one encoder ISR
+struct TickRing {
+  volatile unsigned long stamp[ENCODER_RING_SIZE];  //micros() of each tick
+  volatile uint8_t head;                            //next slot the ISR writes, only the ISR moves it
+  volatile uint8_t tail;                            //next slot update() reads, only update() moves it
+  volatile unsigned int overflows;                  //ticks dropped because the ring was full
+};
+
+static TickRing ring[2];
+static volatile long encoder[2] = {0, 0};  //interrupt variable to hold number of encoder counts (left, right), never reset
+WheelEncoders encoders;
+
+//function to count one tick and record when it happened, runs inside the encoder interrupts
+static inline void recordTick(uint8_t wheel) {
+  TickRing &r = ring[wheel];
+  encoder[wheel]++;
+  uint8_t next = (r.head + 1) & RING_MASK;
+  if (next == r.tail) {
+    r.overflows++;   //update() is behind, keep the count but lose this time stamp
+    return;
+  }
+  r.stamp[r.head] = micros();
+  r.head = next;     //publish the stamp only after it is written
+}
+
+//interrupt function to count left encoder tickes
+static void LwheelSpeed() {
+  PROBE_ISR(PROBE_ENCODER_LEFT);
+  PROFILE_ISR_BEGIN();
+  recordTick(LEFT);
+  PROFILE_ISR_END(PROFILE_ENCODER_LEFT);
+}
+
+//interrupt function to count right encoder ticks
+static void RwheelSpeed() {
+  PROBE_ISR(PROBE_ENCODER_RIGHT);
+  PROFILE_ISR_BEGIN();
+  recordTick(RIGHT);
+  PROFILE_ISR_END(PROFILE_ENCODER_RIGHT);
+}
+
+//function to attach the encoder interrupts
+void WheelEncoders::begin() {
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    lastSpeed[wheel] = 0;
+    stamps[wheel] = 0;
+  }
+  attachInterrupt(digitalPinToInterrupt(ltEncoder), LwheelSpeed, CHANGE);    //init the interrupt mode for the left encoder
+  attachInterrupt(digitalPinToInterrupt(rtEncoder), RwheelSpeed, CHANGE);   //init the interrupt mode for the right encoder
+}
+
+/*
+  Drains the time stamps and refreshes lastSpeed for both wheels.
+  speed = ticks / time between them * cm per tick. When the wait since the last tick is longer than the
+  measured window, the wait is used instead so the speed falls off while the wheel slows down, and after
+  ENCODER_TIMEOUT_US with no tick the speed is 0.
+*/
+void WheelEncoders::update() {
+  unsigned long now = micros();
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    TickRing &r = ring[wheel];
+    uint8_t tail = r.tail;
+    while (tail != r.head) {
+      lastStamp[wheel][2] = lastStamp[wheel][1];
+      lastStamp[wheel][1] = lastStamp[wheel][0];
+      lastStamp[wheel][0] = r.stamp[tail];
+      tail = (tail + 1) & RING_MASK;
+      if (stamps[wheel] < 3) {
+        stamps[wheel]++;
+      }
+    }
+    r.tail = tail;   //hand the slots back to the ISR
+
+    unsigned long idle = now - lastStamp[wheel][0];
+    if (stamps[wheel] < 2 || idle > ENCODER_TIMEOUT_US) {
+      lastSpeed[wheel] = 0;
+      if (stamps[wheel] > 0 && idle > ENCODER_TIMEOUT_US) {
+        stamps[wheel] = 0;   //the next tick starts a new measurement
+      }
+      continue;
+    }
+
+    uint8_t ticks = stamps[wheel] - 1;                     //1 or 2 tick periods in the window
+    unsigned long period = lastStamp[wheel][0] - lastStamp[wheel][ticks];
+    if (idle > period) {
+      period = idle;                                       //slowing down, the next tick is already late
+    }
+    if (period == 0) {
+      continue;
+    }
+    long ticksPerSec = (ticks * 256000000UL) / period;    //tick rate in Q8, good up to 32767 ticks/s
+    fix16 speed = fixMul(ticksPerSec << 8, drive.cmPerTick);
+    lastSpeed[wheel] = stepEngine.direction(wheel) < 0 ? -speed : speed;
+  }
+}
+
+//function to return the ticks a wheel has counted since begin(), read with interrupts off so it cannot tear
+long WheelEncoders::total(uint8_t wheel) {
+  long ticks;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ticks = encoder[wheel];
+  }
+  return ticks;
+}
+
+//function to read both tick counts in the same critical section so they line up with each other
+void WheelEncoders::snapshot(EncoderSnapshot &snap) {
+  unsigned long now = micros();
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    snap.ticks[LEFT] = encoder[LEFT];
+    snap.ticks[RIGHT] = encoder[RIGHT];
+  }
+  snap.time = now;
+}
+
+/*
+  Works out the ticks each wheel has made since the snapshot and moves the snapshot up to now.
+  Nothing is cleared, so a tick that lands between two calls shows up in the next delta instead of being lost.
+*/
+void WheelEncoders::delta(EncoderSnapshot &since, long ticks[2]) {
+  EncoderSnapshot now;
+  snapshot(now);
+  ticks[LEFT] = now.ticks[LEFT] - since.ticks[LEFT];
+  ticks[RIGHT] = now.ticks[RIGHT] - since.ticks[RIGHT];
+  since = now;
+}
+
+//function to return how many time stamps a wheel has dropped
+unsigned int WheelEncoders::overflows(uint8_t wheel) {
+  unsigned int count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = ring[wheel].overflows;
+  }
+  return count;
+}
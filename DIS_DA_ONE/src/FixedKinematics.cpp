@@ -0,0 +1,204 @@
+/*
+  FixedKinematics.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Q16.16 multiply, CORDIC heading/distance and the step/tick conversions used by the motion functions.
+  The multiply is split into 16 x 16 bit products because the AVR multiplier is 8 x 8 bits and 64 bit math
+  pulls in a very slow library routine.
+  CORDIC: https://en.wikipedia.org/wiki/CORDIC
+*/
+
+#include "FixedKinematics.h"
+#include "RobotConfig.h"
+
+#define CORDIC_STEPS 16        //iterations, one bit of angle accuracy each
+#define CORDIC_GAIN_INV 39797L //1 / 1.6467602 in Q16.16, undoes the growth of the vector during the rotations
+
+//atan(2^-i) in degrees, Q16.16
+static const int32_t cordicAngles[CORDIC_STEPS] PROGMEM = {
+  2949120, 1740967, 919879, 466945, 234379, 117304, 58666, 29335,
+  14668, 7334, 3667, 1833, 917, 458, 229, 115
+};
+
+DriveGeometry drive = {
+  toFix(stepsPerRev / wheelCirc),                    // (steps per rotation / distance per rotation)
+  toFix(ticksPerRev / wheelCirc),                    // (ticks per rotation / distance per rotation)
+  toFix(wheelCirc / ticksPerRev),                    // (distance per rotation / ticks per rotation)
+  toFix(stepsPerRev / ticksPerRev / spinDegPerTick), // steps per tick / degrees per tick
+  toFix(1.0 / spinDegPerTick),                       // ticks per degree
+  toFix(spinDegPerTick),                             // degrees per tick
+  toFix(stepsPerRev / wheelDiam),                    // steps per cm of circle diameter
+  toFix(robotDiam)                                   // center to center of the wheels
+};
+
+//function to work out the full 64 bit product of two Q16.16 numbers as a high and a low 32 bit half
+static void mul64(fix16 a, fix16 b, int32_t *hi, uint32_t *lo) {
+  int16_t A = a >> 16;          //whole parts
+  int16_t C = b >> 16;
+  uint16_t B = a & 0xFFFF;      //fractions
+  uint16_t D = b & 0xFFFF;
+
+  int32_t AC = (int32_t)A * C;
+  int32_t AD = (int32_t)A * D;
+  int32_t CB = (int32_t)C * B;
+  uint32_t BD = (uint32_t)B * D;
+
+  int32_t productHi = AC + (AD >> 16) + (CB >> 16);
+  uint32_t productLo = BD;
+  uint32_t part = (uint32_t)AD << 16;
+  productLo += part;
+  if (productLo < part) {
+    productHi++;  //carry into the high half
+  }
+  part = (uint32_t)CB << 16;
+  productLo += part;
+  if (productLo < part) {
+    productHi++;  //carry into the high half
+  }
+  *hi = productHi;
+  *lo = productLo;
+}
+
+//function to multiply two Q16.16 numbers, rounded to the nearest 1/65536
+fix16 fixMul(fix16 a, fix16 b) {
+  int32_t hi;
+  uint32_t lo;
+  mul64(a, b, &hi, &lo);
+  fix16 result = (fix16)(((uint32_t)hi << 16) | (lo >> 16));
+  if (lo & 0x8000) {
+    result++;
+  }
+  return result;
+}
+
+//function to multiply two Q16.16 numbers and round the result to a whole number
+long fixMulToInt(fix16 a, fix16 b) {
+  int32_t hi;
+  uint32_t lo;
+  mul64(a, b, &hi, &lo);
+  return hi + (int32_t)(lo >> 31);  //round on the top bit of the low half
+}
+
+/*
+  CORDIC in vectoring mode: rotates (x, y) onto the x axis in shrinking steps, adding up the angle it turned.
+  The angle is returned in degrees (-180 to 180) and the length is what is left on the x axis.
+*/
+void fixPolar(fix16 x, fix16 y, fix16 *angle, fix16 *length) {
+  fix16 z = 0;
+  if (x < 0) {  //rotate by 180 degrees into the right half plane first
+    z = y >= 0 ? toFix(180) : toFix(-180);
+    x = -x;
+    y = -y;
+  }
+  for (uint8_t i = 0; i < CORDIC_STEPS; i++) {
+    fix16 dx = x >> i;
+    fix16 dy = y >> i;
+    fix16 step = pgm_read_dword(&cordicAngles[i]);
+    if (y > 0) {  //rotate clockwise
+      x += dy;
+      y -= dx;
+      z += step;
+    } else {      //rotate counterclockwise
+      x -= dy;
+      y += dx;
+      z -= step;
+    }
+  }
+  if (angle) {
+    *angle = z;
+  }
+  if (length) {
+    *length = fixMul(x, CORDIC_GAIN_INV);
+  }
+}
+
+/*
+  CORDIC in rotation mode: starts from (1 / gain, 0) and rotates it by the angle in shrinking steps, what is left
+  is (cos, sin). Angles outside -90 to 90 degrees are turned around by 180 degrees first.
+*/
+void fixSinCos(fix16 degrees, fix16 *sine, fix16 *cosine) {
+  fix16 z = fixWrapDegrees(degrees);
+  bool flip = false;
+  if (z > toFix(90)) {
+    z -= toFix(180);
+    flip = true;
+  } else if (z < toFix(-90)) {
+    z += toFix(180);
+    flip = true;
+  }
+  fix16 x = CORDIC_GAIN_INV;
+  fix16 y = 0;
+  for (uint8_t i = 0; i < CORDIC_STEPS; i++) {
+    fix16 dx = x >> i;
+    fix16 dy = y >> i;
+    fix16 step = pgm_read_dword(&cordicAngles[i]);
+    if (z > 0) {  //rotate counterclockwise
+      x -= dy;
+      y += dx;
+      z -= step;
+    } else {      //rotate clockwise
+      x += dy;
+      y -= dx;
+      z += step;
+    }
+  }
+  if (sine) {
+    *sine = flip ? -y : y;
+  }
+  if (cosine) {
+    *cosine = flip ? -x : x;
+  }
+}
+
+//function to bring an angle in degrees back into -180 to 180
+fix16 fixWrapDegrees(fix16 degrees) {
+  while (degrees > toFix(180)) {
+    degrees -= toFix(360);
+  }
+  while (degrees <= toFix(-180)) {
+    degrees += toFix(360);
+  }
+  return degrees;
+}
+
+//function to return the wheel steps for a straight move in cm
+long stepsForDistance(fix16 cm) {
+  return fixMulToInt(cm, drive.stepsPerCm);
+}
+
+//function to return the encoder ticks for a straight move in cm
+fix16 ticksForDistance(fix16 cm) {
+  return fixMul(cm, drive.ticksPerCm);
+}
+
+//function to return the wheel steps for a spin in place in degrees
+long stepsForSpin(fix16 degrees) {
+  return fixMulToInt(degrees, drive.stepsPerDegree);
+}
+
+//function to return the encoder ticks for a spin in place in degrees
+fix16 ticksForSpin(fix16 degrees) {
+  return fixMul(degrees, drive.ticksPerDegree);
+}
+
+//function to return the wheel steps for one lap of a circle of the given diameter in cm
+long stepsForCircle(fix16 diameter) {
+  return fixMulToInt(diameter, drive.stepsPerCmCircle);
+}
+
+/*
+  Rebuilds every conversion factor from a wheel circumference and track width in cm and the encoder ticks per wheel
+  rotation, the same formulas as the compile time table above. Float math, it only runs at boot and after a
+  calibration trial.
+*/
+void setDriveGeometry(float circumference, float trackWidth, float ticksPerRotation) {
+  float degreesPerTick = circumference / ticksPerRotation / (PI * trackWidth) * 360;   //each wheel rolls along the spin circle
+  drive.stepsPerCm = toFix(stepsPerRev / circumference);
+  drive.ticksPerCm = toFix(ticksPerRotation / circumference);
+  drive.cmPerTick = toFix(circumference / ticksPerRotation);
+  drive.stepsPerDegree = toFix(stepsPerRev / ticksPerRotation / degreesPerTick);
+  drive.ticksPerDegree = toFix(1.0 / degreesPerTick);
+  drive.degreesPerTick = toFix(degreesPerTick);
+  drive.stepsPerCmCircle = toFix(stepsPerRev * PI / circumference);
+  drive.trackWidth = toFix(trackWidth);
+}
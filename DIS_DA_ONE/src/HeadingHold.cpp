@@ -0,0 +1,148 @@
+/*
+  HeadingHold.cpp
+  Kyzer Bowen, Tyce Miller
+
+  PI heading hold on the gyro for straight motion segments, see HeadingHold.h.
+  Anti-windup like WheelControl.cpp: the integral stops growing while the trim is saturated in the direction of the
+  error, and is clamped to HEADING_I_LIMIT either way. Steering stops once the wheels are on their last steps, the
+  ramp down is too short to correct anything.
+*/
+
+#include "HeadingHold.h"
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include "Odometry.h"
+
+#define HEADING_DT toFix(HEADING_PERIOD_US / 1000000.0)   //control period in s, Q16.16
+#define HEADING_I_LIMIT toFix(5.0)                          //largest integral in degree*s
+
+HeadingHold headingHold;
+
+//function to load the default gains
+void HeadingHold::begin() {
+  setGains(toFix(30.0), toFix(15.0));
+  active = false;
+  err = 0;
+}
+
+//function to set the PI gains, steps/s of wheel speed difference per degree of heading error
+void HeadingHold::setGains(fix16 kp, fix16 ki) {
+  this->kp = kp;
+  this->ki = ki;
+}
+
+//function to start steering a segment from the heading the robot has now, call it while the wheels are still stopped
+void HeadingHold::start(const MotionSegment &segment) {
+  planned = labs(segment.steps[RIGHT]);
+  spinning = (segment.steps[RIGHT] < 0) != (segment.steps[LEFT] < 0);
+  dir = segment.steps[RIGHT] < 0 ? -1 : 1;
+  speed = segment.speed[RIGHT];
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    startPos[wheel] = stepEngine.currentPosition(wheel);
+  }
+  target = spinning ? segment.angle : odometry.gyroHeading();
+  last = odometry.gyroHeading();
+  turned = 0;
+  still = 0;
+  err = spinning ? segment.angle : 0;
+  integral = 0;
+  offset = 0;
+  active = true;
+}
+
+//function to run one period while a segment is steered
+void HeadingHold::update() {
+  if (!active) {
+    return;
+  }
+  if (spinning) {
+    holdSpin();
+  } else {
+    holdStraight();
+  }
+}
+
+/*
+  One straight period.
+  error = heading to hold - gyro heading, positive when the robot has turned clockwise and has to come back left
+  half = (kp * error + ki * integral) / 2, the right wheel goes half faster and the left half slower (reversed in reverse)
+  targets = steps each wheel has made + the same steps still to go for both
+*/
+void HeadingHold::holdStraight() {
+  long made[2];
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    made[wheel] = labs(stepEngine.currentPosition(wheel) - startPos[wheel]);
+  }
+  long remaining = planned - (made[RIGHT] + made[LEFT]) / 2;
+  if (remaining <= 0) {
+    return;
+  }
+
+  err = fixWrapDegrees(target - odometry.gyroHeading());
+  fix16 lastIntegral = integral;
+  integral += fixMul(err, HEADING_DT);
+  integral = constrain(integral, -HEADING_I_LIMIT, HEADING_I_LIMIT);
+  fix16 trim = fixMul(kp, err) + fixMul(ki, integral);
+  float half = trim / 131072.0;   //Q16.16 to steps/s, halved
+  float maxTrim = speed * HEADING_MAX_TRIM / 100;
+  if (half > maxTrim || half < -maxTrim) {
+    half = half > 0 ? maxTrim : -maxTrim;
+    if ((err > 0) == (trim > 0)) {
+      integral = lastIntegral;  //saturated, do not wind up
+    }
+  }
+  stepEngine.setMaxSpeed(RIGHT, speed + dir * half);
+  stepEngine.setMaxSpeed(LEFT, speed - dir * half);
+
+  //keep the steering the trim has done, both wheels get the same steps still to go
+  long madeOffset = (made[RIGHT] - made[LEFT]) / 2;
+  if (madeOffset != offset) {
+    offset = madeOffset;
+    stepEngine.moveTo(RIGHT, startPos[RIGHT] + dir * (made[RIGHT] + remaining));
+    stepEngine.moveTo(LEFT, startPos[LEFT] + dir * (made[LEFT] + remaining));
+  }
+}
+
+/*
+  One spin period.
+  error = segment angle - angle the gyro has turned, positive means more counterclockwise to go
+  right target = right position + error * steps per degree, left target = left position - the same
+  With the wheels stopped the error is only acted on once it is past HEADING_TOLERANCE.
+*/
+void HeadingHold::holdSpin() {
+  fix16 heading = odometry.gyroHeading();
+  turned += fixWrapDegrees(heading - last);   //wrapped a period at a time so spins past 180 degrees add up
+  last = heading;
+  err = target - turned - fixMul(odometry.gyroYawRate(), HEADING_LEAD);   //where the robot is now, not where the gyro last saw it
+
+  long made = labs(stepEngine.currentPosition(RIGHT) - startPos[RIGHT]);
+  if (made > planned + planned * HEADING_MAX_EXTRA / 100) {
+    still = HEADING_SETTLE;   //far past the plan, the gyro can not be right
+    return;
+  }
+  bool running = stepEngine.isRunning(RIGHT) || stepEngine.isRunning(LEFT);
+  if (!running && err <= HEADING_TOLERANCE && err >= -HEADING_TOLERANCE) {
+    if (still < HEADING_SETTLE) {
+      still++;
+    }
+    return;
+  }
+  long togo = fixMulToInt(err, drive.stepsPerDegree);
+  if (!running && togo == 0) {
+    still = HEADING_SETTLE;   //off by less than a step
+    return;
+  }
+  still = 0;
+  stepEngine.moveTo(RIGHT, stepEngine.currentPosition(RIGHT) + togo);
+  stepEngine.moveTo(LEFT, stepEngine.currentPosition(LEFT) - togo);
+}
+
+//function to stop steering, the wheels finish whatever target they have
+void HeadingHold::stop() {
+  active = false;
+}
+
+//function to tell if the segment is done as far as the heading goes, a spin once it has settled on its angle
+bool HeadingHold::settled() {
+  return !active || !spinning || still >= HEADING_SETTLE;
+}
@@ -0,0 +1,253 @@
+/*
+  Imu.cpp
+  Kyzer Bowen, Tyce Miller
+
+  MPU6050 setup and the interrupt chain that empties its FIFO, see Imu.h.
+  data ready (INT4) -> read FIFO_COUNT -> read up to IMU_BURST samples from FIFO_R_W -> ring buffer
+  If the INT pulse comes while the bus is busy it is remembered and the FIFO is checked again when the burst ends.
+  The ring has one writer (the TWI interrupt moves head) and one reader (read() moves tail).
+*/
+
+#include "Imu.h"
+#include "RobotConfig.h"
+#include "Twi.h"
+#include <util/atomic.h>
+
+//MPU6050 registers
+#define MPU_SMPLRT_DIV 0x19
+#define MPU_CONFIG 0x1A
+#define MPU_GYRO_CONFIG 0x1B
+#define MPU_ACCEL_CONFIG 0x1C
+#define MPU_FIFO_EN 0x23
+#define MPU_INT_PIN_CFG 0x37
+#define MPU_INT_ENABLE 0x38
+#define MPU_USER_CTRL 0x6A
+#define MPU_PWR_MGMT_1 0x6B
+#define MPU_FIFO_COUNTH 0x72
+#define MPU_FIFO_R_W 0x74
+#define MPU_WHO_AM_I 0x75
+
+#define MPU_ID 0x68                              //WHO_AM_I value
+
+#define MPU_FIFO_SIZE 1024                       //bytes in the MPU6050 FIFO
+#define IMU_PACKET 14                            //accel, temperature and gyro, 2 bytes each
+#define RING_MASK (IMU_RING_SIZE - 1)
+
+static ImuSample ring[IMU_RING_SIZE];
+static volatile uint8_t head = 0;                //next slot the TWI interrupt fills
+static volatile uint8_t tail = 0;                //next slot read() empties
+static volatile unsigned int lost = 0;           //samples dropped
+static volatile bool pending = false;            //data ready came while the bus was busy
+static volatile bool more = false;               //the FIFO held more than one burst
+static volatile bool received = false;           //at least one sample has come in
+
+static uint8_t countBytes[2];
+static uint8_t burstBytes[IMU_BURST * IMU_PACKET];
+static uint8_t fifoResetValue = 0x44;            //USER_CTRL: FIFO_EN | FIFO_RESET
+
+static void countDone(bool ok);
+static void burstDone(bool ok);
+static void resetDone(bool ok);
+
+static TwiTransfer countRead = {MPU_ADDRESS, MPU_FIFO_COUNTH, countBytes, 2, true, countDone};
+static TwiTransfer burstRead = {MPU_ADDRESS, MPU_FIFO_R_W, burstBytes, 0, true, burstDone};
+static TwiTransfer fifoReset = {MPU_ADDRESS, MPU_USER_CTRL, &fifoResetValue, 1, false, resetDone};
+
+MpuImu imu;
+
+//function to check the FIFO again, or remember to once the bus is free
+static void checkFifo() {
+  if (!twiStart(&countRead)) {
+    pending = true;
+  }
+}
+
+//interrupt function for the MPU6050 data ready pulse
+static void dataReady() {
+  checkFifo();
+}
+
+//function to start the next FIFO check if one was asked for while the bus was busy
+static void checkPending() {
+  if (pending || more) {
+    pending = false;
+    more = false;
+    checkFifo();
+  }
+}
+
+//TWI interrupt: FIFO count is in, read the whole samples waiting (or reset the FIFO if it overflowed)
+static void countDone(bool ok) {
+  if (!ok) {
+    checkPending();
+    return;
+  }
+  unsigned int count = ((unsigned int)countBytes[0] << 8) | countBytes[1];
+  if (count > MPU_FIFO_SIZE - IMU_PACKET) {
+    lost += count / IMU_PACKET;   //FIFO overflowed, samples are no longer aligned
+    twiStart(&fifoReset);
+    return;
+  }
+  uint8_t samples = count / IMU_PACKET;
+  more = samples > IMU_BURST;
+  if (samples > IMU_BURST) {
+    samples = IMU_BURST;
+  }
+  if (samples == 0) {
+    checkPending();
+    return;
+  }
+  burstRead.length = samples * IMU_PACKET;
+  twiStart(&burstRead);
+}
+
+//TWI interrupt: burst is in, unpack the big endian samples into the ring
+static void burstDone(bool ok) {
+  if (ok) {
+    for (uint8_t i = 0; i < burstRead.length; i += IMU_PACKET) {
+      uint8_t next = (head + 1) & RING_MASK;
+      if (next == tail) {
+        lost++;   //the foreground is behind, drop the sample
+        continue;
+      }
+      int16_t *words = (int16_t *)&ring[head];
+      for (uint8_t j = 0; j < IMU_PACKET / 2; j++) {
+        words[j] = (int16_t)((burstBytes[i + 2 * j] << 8) | burstBytes[i + 2 * j + 1]);
+      }
+      head = next;
+      received = true;
+    }
+  }
+  checkPending();
+}
+
+//TWI interrupt: FIFO reset is done
+static void resetDone(bool ok) {
+  checkPending();
+}
+
+/*
+  Sets up the MPU6050 with the blocking TWI calls, returns false if the chip does not answer.
+  Gyro +-500 degrees/s, accel +-8 g, 44 Hz low pass, IMU_SAMPLE_HZ samples into the FIFO and a data ready pulse on INT.
+  Waits IMU_RESET_MS for the reset, the boot sequence calls reset() and configure() itself and runs meanwhile.
+*/
+bool MpuImu::begin() {
+  if (!reset()) {
+    return false;
+  }
+  delay(IMU_RESET_MS);
+  return configure();
+}
+
+//function to check the chip is there and reset it, false if it does not answer (one TWI_TIMEOUT_MS at most)
+bool MpuImu::reset() {
+  twiBegin(400000);   //fast mode
+  uint8_t id = 0;
+  if (!twiReadRegisters(MPU_ADDRESS, MPU_WHO_AM_I, &id, 1) || id != MPU_ID) {
+    return false;
+  }
+  return twiWriteRegister(MPU_ADDRESS, MPU_PWR_MGMT_1, 0x80);
+}
+
+//function to set the ranges, sample rate and FIFO and attach the INT interrupt, IMU_RESET_MS after reset()
+bool MpuImu::configure() {
+  bool ok = twiWriteRegister(MPU_ADDRESS, MPU_PWR_MGMT_1, 0x01);                          //wake up, clock from the X gyro
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_CONFIG, 0x03);                             //44 Hz low pass, 1 kHz gyro rate
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_SMPLRT_DIV, 1000 / IMU_SAMPLE_HZ - 1);     //sample rate = 1 kHz / (1 + div)
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_GYRO_CONFIG, 0x08);                        //+-500 degrees/s
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_ACCEL_CONFIG, 0x10);                       //+-8 g
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_INT_PIN_CFG, 0x10);                        //active high pulse, cleared by any read
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_USER_CTRL, 0x04);                          //reset the FIFO
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_USER_CTRL, 0x40);                          //FIFO on
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_FIFO_EN, 0xF8);                            //temperature, gyro x y z and accel into the FIFO
+  ok = ok && twiWriteRegister(MPU_ADDRESS, MPU_INT_ENABLE, 0x01);                         //data ready interrupt
+  if (!ok) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 3; i++) {
+    gyroBias[i] = 0;
+  }
+  attachInterrupt(digitalPinToInterrupt(imuIntPin), dataReady, RISING);
+  return true;
+}
+
+//function to average the gyro over a number of samples while the robot is still, false if the samples stop coming
+bool MpuImu::calibrate(uint16_t samples) {
+  unsigned long start = millis();
+  calibrateStart();
+  while (!calibratePoll(samples)) {
+    if (millis() - start > 2UL * samples * 1000 / IMU_SAMPLE_HZ + 100) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//function to start a gyro zero rate average over, the old zero is dropped so read() gives raw samples meanwhile
+void MpuImu::calibrateStart() {
+  for (uint8_t i = 0; i < 3; i++) {
+    gyroBias[i] = 0;
+    biasSum[i] = 0;
+  }
+  biasCount = 0;
+}
+
+//function to add the waiting samples to the average, true once it has the number asked for and the zero is set
+bool MpuImu::calibratePoll(uint16_t samples) {
+  ImuSample sample;
+  while (biasCount < samples && read(sample)) {
+    for (uint8_t i = 0; i < 3; i++) {
+      biasSum[i] += sample.gyro[i];
+    }
+    biasCount++;
+  }
+  if (biasCount < samples) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 3; i++) {
+    gyroBias[i] = biasSum[i] / samples;
+  }
+  return true;
+}
+
+//function to pop the oldest sample with the gyro zero rate taken off, false when the ring is empty
+bool MpuImu::read(ImuSample &sample) {
+  uint8_t slot = tail;
+  if (slot == head) {
+    return false;
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    sample = ring[slot];
+  }
+  tail = (slot + 1) & RING_MASK;
+  for (uint8_t i = 0; i < 3; i++) {
+    sample.gyro[i] -= gyroBias[i];
+  }
+  return true;
+}
+
+//function to copy the newest sample without popping it, false if nothing has come in yet
+bool MpuImu::latest(ImuSample &sample) {
+  bool found = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (received) {
+      sample = ring[(head - 1) & RING_MASK];
+      found = true;
+    }
+  }
+  if (found) {
+    for (uint8_t i = 0; i < 3; i++) {
+      sample.gyro[i] -= gyroBias[i];
+    }
+  }
+  return found;
+}
+
+//function to return how many samples have been lost
+unsigned int MpuImu::overflows() {
+  unsigned int count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = lost;
+  }
+  return count;
+}
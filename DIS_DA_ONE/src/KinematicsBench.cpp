@@ -0,0 +1,119 @@
+/*
+  KinematicsBench.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Compares the float math the motion functions used to do with the fixed point versions in FixedKinematics.cpp.
+  Only built with -D KINEMATICS_BENCHMARK (pio run -e kinematics_benchmark), prints CPU cycles per call and the
+  worst difference between the two paths to the serial monitor once at startup.
+*/
+
+#ifdef KINEMATICS_BENCHMARK
+
+#include "FixedKinematics.h"
+#include "RobotConfig.h"
+
+#define BENCH_RUNS 500    //calls per measurement, micros() has 4 us resolution
+
+static volatile int benchInput[8] = {5, 17, 33, 50, 75, 120, 200, 333};  //volatile so the compiler cannot fold the math away
+static volatile long sinkLong;
+static volatile float sinkFloat;
+
+//function to turn a micros() interval into CPU cycles per call
+static unsigned long cyclesPerCall(unsigned long elapsed) {
+  return (elapsed * (F_CPU / 1000000UL)) / BENCH_RUNS;
+}
+
+//function to print one benchmark line
+static void print_result(const char *name, unsigned long floatCycles, unsigned long fixedCycles) {
+  Serial.print(name);
+  Serial.print("\tfloat: ");
+  Serial.print(floatCycles);
+  Serial.print("\tfixed: ");
+  Serial.println(fixedCycles);
+}
+
+//function to time the float and fixed point paths of forward(), moveCircle() and goToGoal()
+void benchmark_kinematics() {
+  unsigned long start, floatCycles, fixedCycles;
+  Serial.println("Kinematics benchmark (CPU cycles per call)");
+
+  // forward(): steps for a distance
+  start = micros();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    int distance = benchInput[i & 7];
+    sinkLong = (800 / wheelCirc) * distance;
+  }
+  floatCycles = cyclesPerCall(micros() - start);
+  start = micros();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    int distance = benchInput[i & 7];
+    sinkLong = stepsForDistance(fixFromInt(distance));
+  }
+  fixedCycles = cyclesPerCall(micros() - start);
+  print_result("forward steps", floatCycles, fixedCycles);
+
+  // moveCircle(): inner and outer wheel steps and the inner wheel speed
+  start = micros();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    int diam = benchInput[i & 7] + 30;
+    float innerTicks = (800 / wheelCirc) * ((diam - robotDiam) * PI);
+    float outterTicks = (800 / wheelCirc) * ((diam + robotDiam) * PI);
+    sinkFloat = (innerTicks / outterTicks) * 500;
+  }
+  floatCycles = cyclesPerCall(micros() - start);
+  start = micros();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    int diam = benchInput[i & 7] + 30;
+    long innerSteps = stepsForCircle(fixFromInt(diam) - drive.trackWidth);
+    long outterSteps = stepsForCircle(fixFromInt(diam) + drive.trackWidth);
+    sinkLong = (500 * innerSteps + outterSteps / 2) / outterSteps;
+  }
+  fixedCycles = cyclesPerCall(micros() - start);
+  print_result("circle steps", floatCycles, fixedCycles);
+
+  // goToGoal(): heading and distance
+  start = micros();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    float x = benchInput[i & 7];
+    float y = benchInput[(i + 3) & 7] - 100;
+    sinkFloat = atan2(y, x) * (180 / PI);
+    sinkFloat = sqrt((x * x) + (y * y));
+  }
+  floatCycles = cyclesPerCall(micros() - start);
+  start = micros();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    fix16 x = fixFromInt(benchInput[i & 7]);
+    fix16 y = fixFromInt(benchInput[(i + 3) & 7] - 100);
+    fix16 angle, distance;
+    fixPolar(x, y, &angle, &distance);
+    sinkLong = angle + distance;
+  }
+  fixedCycles = cyclesPerCall(micros() - start);
+  print_result("goal heading", floatCycles, fixedCycles);
+
+  // accuracy of the CORDIC over the range goToGoal() is used for
+  float worstAngle = 0;
+  float worstDistance = 0;
+  for (int y = -200; y <= 200; y += 25) {
+    for (int x = -200; x <= 200; x += 25) {
+      if (x == 0 && y == 0) {
+        continue;
+      }
+      fix16 angle, distance;
+      fixPolar(fixFromInt(x), fixFromInt(y), &angle, &distance);
+      float angleError = fabs(angle / 65536.0 - atan2(y, x) * (180 / PI));
+      if (angleError > 180) {
+        angleError = fabs(angleError - 360);  //-180 and 180 are the same heading
+      }
+      float distanceError = fabs(distance / 65536.0 - sqrt((float)x * x + (float)y * y));
+      worstAngle = max(worstAngle, angleError);
+      worstDistance = max(worstDistance, distanceError);
+    }
+  }
+  Serial.print("CORDIC worst error\tangle (deg): ");
+  Serial.print(worstAngle, 4);
+  Serial.print("\tdistance (cm): ");
+  Serial.println(worstDistance, 4);
+}
+
+#endif
@@ -0,0 +1,265 @@
+/*
+  MotionQueue.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Runs queued motion segments on the step engine one after another without blocking the caller.
+  Everything here runs in the foreground from service(), only the step engine touches interrupts.
+*/
+
+#include "MotionQueue.h"
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include "WheelControl.h"
+#include "PathFollower.h"
+#include "HeadingHold.h"
+#include "Odometry.h"
+#include "Probes.h"
+
+#define PATH 2   //junctionLimit() and junctionSpeed() index for the path of linked segments
+
+MotionQueue motionQueue;
+
+//function to return the steps of the larger wheel, the path steps of a linked segment
+static long majorSteps(const MotionSegment &segment) {
+  long right = labs(segment.steps[RIGHT]);
+  long left = labs(segment.steps[LEFT]);
+  return right > left ? right : left;
+}
+
+//function to return the speed of the faster wheel, the path speed of a linked segment
+static float majorSpeed(const MotionSegment &segment) {
+  return max(segment.speed[RIGHT], segment.speed[LEFT]);
+}
+
+//function to set up an empty queue
+void MotionQueue::begin() {
+  wheelControl.begin();
+  pathFollower.begin();
+  headingHold.begin();
+  head = 0;
+  count = 0;
+  active = false;
+  moving = false;
+  chainedNext = false;
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    stepEngine.setAcceleration(wheel, MOTION_ACCELERATION);
+    stepEngine.setJerk(wheel, MOTION_JERK);
+  }
+  nextId = 1;
+  doneId = 0;
+}
+
+//function to add a segment to the end of the queue, returns the segment number or 0 if the queue is full
+unsigned int MotionQueue::push(const MotionSegment &segment) {
+  if (count >= MOTION_QUEUE_SIZE) {
+    return 0;
+  }
+  uint8_t tail = (head + count) % MOTION_QUEUE_SIZE;
+  queue[tail] = segment;
+  queue[tail].id = nextId;
+  count++;
+  nextId++;
+  if (nextId == 0) {
+    nextId = 1; //0 is reserved for a full queue
+  }
+  return queue[tail].id;
+}
+
+//function to hand a segment to the step engine
+void MotionQueue::start(const MotionSegment &segment) {
+  current = segment;
+  active = true;
+  moving = true;
+  if (segment.flags & SEG_GOAL) {
+    pathFollower.start(segment);//the follower sets the wheel speeds from the pose, no step targets
+    return;
+  }
+  if (segment.flags & SEG_LINKED) {
+    stepEngine.moveLinked(segment.steps, majorSpeed(segment));//one ramp for both wheels, the faster wheel sets the pace
+    return;
+  }
+  if ((segment.flags & SEG_HEADING) && odometry.hasGyro()) {
+    headingHold.start(segment);//steer by the gyro for this segment
+  } else if (segment.flags & SEG_CORRECT) {
+    wheelControl.start(segment);//close the loop on the encoders for this segment
+  }
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    stepEngine.setMaxSpeed(wheel, segment.speed[wheel]);//set motor speed
+  }
+  stepEngine.move(RIGHT, segment.steps[RIGHT]);//move right motor
+  stepEngine.move(LEFT, segment.steps[LEFT]);//move left motor
+}
+
+//function to tell if the wheels can run from one segment into the next without stopping
+bool MotionQueue::blends(const MotionSegment &from, const MotionSegment &to) {
+  if (from.dwell) {
+    return false;
+  }
+  if (from.flags == SEG_LINKED && to.flags == SEG_LINKED) {
+    return majorSteps(to) > 0;
+  }
+  if (from.flags || to.flags) {
+    return false;
+  }
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    if (from.steps[wheel] == 0 || to.steps[wheel] == 0 || (from.steps[wheel] > 0) != (to.steps[wheel] > 0)) {
+      return false;   //a wheel stops or turns around at the junction
+    }
+  }
+  return true;
+}
+
+/*
+  Highest speed of a wheel (or of the PATH for linked segments) where two segments meet, 0 if they do not blend.
+  Linked: the wheel speeds at the junction are path speed * steps / path steps on each side, so a change of
+  curvature makes each wheel jump by path speed * the change in its share, which must stay under MOTION_MAX_JUMP.
+*/
+float MotionQueue::junctionLimit(const MotionSegment &before, const MotionSegment &after, uint8_t wheel) {
+  if (!blends(before, after)) {
+    return 0;
+  }
+  if (wheel != PATH) {
+    return min(before.speed[wheel], after.speed[wheel]);
+  }
+  float limit = min(majorSpeed(before), majorSpeed(after));
+  for (uint8_t i = 0; i < 2; i++) {
+    float jump = fabs((float)before.steps[i] / majorSteps(before) - (float)after.steps[i] / majorSteps(after));
+    if (jump * limit > MOTION_MAX_JUMP) {
+      limit = MOTION_MAX_JUMP / jump;
+    }
+  }
+  return limit;
+}
+
+/*
+  Junction speed between the current segment and the first queued one for a wheel (or the PATH).
+  Backward pass: the last queued segment ends stopped, going back through the queue each junction is the lower of
+  its own limit and (in steps to stop) the junction after it plus the steps of the segment between, so the wheel
+  can always slow down for everything behind it.
+*/
+float MotionQueue::junctionSpeed(uint8_t wheel) {
+  float stopSteps = 0;   //steps to stop at the end of the segment being looked at
+  uint8_t ramp = wheel == PATH ? RIGHT : wheel;   //both wheels have the same ramp settings
+  for (uint8_t i = count; i > 0; i--) {
+    const MotionSegment &before = i > 1 ? queue[(head + i - 2) % MOTION_QUEUE_SIZE] : current;
+    const MotionSegment &after = queue[(head + i - 1) % MOTION_QUEUE_SIZE];
+    float limit = junctionLimit(before, after, wheel);
+    long steps = wheel == PATH ? majorSteps(after) : labs(after.steps[wheel]);
+    stopSteps = min(stepEngine.stoppingSteps(ramp, limit), stopSteps + steps);
+  }
+  return stepEngine.stoppingSpeed(ramp, stopSteps);
+}
+
+//function to chain the first queued segment behind the current one if the two blend
+void MotionQueue::chainNext() {
+  if (count == 0 || !blends(current, queue[head])) {
+    return;
+  }
+  const MotionSegment &next = queue[head];
+  if (next.flags & SEG_LINKED) {
+    chainedNext = stepEngine.chainLinked(next.steps, majorSpeed(next), junctionSpeed(PATH));
+    return;
+  }
+  float junction[2];
+  junction[RIGHT] = junctionSpeed(RIGHT);
+  junction[LEFT] = junctionSpeed(LEFT);
+  chainedNext = stepEngine.chain(next.steps, next.speed, junction);   //false once a wheel has already stopped
+}
+
+//function to start segments as the wheels finish, call it every scheduler pass
+void MotionQueue::service() {
+  PROBE(PROBE_QUEUE);
+  if (active && chainedNext) {
+    if (stepEngine.chained(RIGHT) || stepEngine.chained(LEFT)) {
+      return;   //a wheel is still on the current segment
+    }
+    finished(current.id);   //both wheels are into the chained segment, it becomes the current one
+    current = queue[head];
+    head = (head + 1) % MOTION_QUEUE_SIZE;
+    count--;
+    chainedNext = false;
+  }
+  if (active) {
+    if (moving) {
+      if (!chainedNext) {
+        chainNext();
+      }
+      if (stepEngine.isRunning() || !wheelControl.settled() || !headingHold.settled() || pathFollower.active()) {
+        return; //segment still in progress
+      }
+      moving = false;
+      wheelControl.stop();
+      headingHold.stop();
+      dwellStart = millis();
+    }
+    if (millis() - dwellStart < current.dwell) {
+      return; //pausing after the segment
+    }
+    active = false;
+    finished(current.id);
+  }
+
+  if (count == 0) {
+    return;
+  }
+  MotionSegment next = queue[head];
+  head = (head + 1) % MOTION_QUEUE_SIZE;
+  count--;
+  start(next);
+}
+
+//function to drop every queued segment and decelerate the wheels to a stop
+void MotionQueue::clear() {
+  count = 0;
+  chainedNext = false;
+  if (active) {
+    wheelControl.stop();
+    pathFollower.stop();
+    headingHold.stop();
+    current.dwell = 0;
+    stepEngine.stop(RIGHT);//stop right motor
+    stepEngine.stop(LEFT);//stop left motor
+  }
+  doneId = nextId - 1;
+}
+
+//function to mark a segment finished, doneId only moves forward so a segment clear() dropped stays done
+void MotionQueue::finished(unsigned int id) {
+  if ((int)(id - doneId) > 0) {
+    doneId = id;
+  }
+}
+
+//function to tell if any segment is running or waiting
+bool MotionQueue::busy() {
+  return active || count > 0;
+}
+
+//function to return the number of the segment being run (or the last one run)
+unsigned int MotionQueue::segmentIndex() {
+  return current.id;
+}
+
+//function to tell if the segment with the number returned by push() has finished
+bool MotionQueue::isDone(unsigned int id) {
+  return (int)(doneId - id) >= 0;
+}
+
+//function to return the steps left on the longer wheel for the current segment plus everything queued
+long MotionQueue::remainingSteps() {
+  long total = 0;
+  if (active) {
+    long right = labs(stepEngine.distanceToGo(RIGHT));
+    long left = labs(stepEngine.distanceToGo(LEFT));
+    total = right > left ? right : left;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    total += majorSteps(queue[(head + i) % MOTION_QUEUE_SIZE]);
+  }
+  return total;
+}
+
+//function to return the number of segments that can still be pushed
+uint8_t MotionQueue::freeSlots() {
+  return MOTION_QUEUE_SIZE - count;
+}
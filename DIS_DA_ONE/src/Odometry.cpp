@@ -0,0 +1,100 @@
+/*
+  Odometry.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Pose estimate from the encoders and the gyro, see Odometry.h.
+  The encoders do not know direction, so each wheel's ticks take the sign of its last step from the step engine.
+*/
+
+#include "Odometry.h"
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include "Probes.h"
+
+#define MAX_DT_US 1000000UL   //longest period the gyro is integrated over, a stalled loop should not throw the heading
+
+Odometry odometry;
+
+//function to start the pose at the origin facing along the x axis
+void Odometry::begin() {
+  setGyro(0);
+  reset(0, 0, 0);
+}
+
+//function to set where the yaw rate comes from, pass 0 to use the encoders alone
+void Odometry::setGyro(bool (*readRate)(fix16 *degreesPerSec)) {
+  readGyro = readRate;
+  gyroRaw = 0;
+  gyroBias = 0;   //the IMU took its own zero before it was handed over
+  gyroRate = 0;
+  still = 0;
+  gyroAngle = current.heading;
+}
+
+//function to move the pose to a known position, the encoder heading follows so the filter does not pull it back
+void Odometry::reset(fix16 x, fix16 y, fix16 heading) {
+  current.x = x;
+  current.y = y;
+  current.heading = fixWrapDegrees(heading);
+  gyroAngle = current.heading;
+  encoders.snapshot(mark);
+  lastRun = micros();
+}
+
+/*
+  One odometry period.
+  left, right = wheel travel in cm since the last period
+  with the gyro: heading += (gyro reading - bias) * dt, bias += (gyro reading - bias) * GYRO_BIAS_WEIGHT when still
+  without: heading += (right - left) ticks * degrees per tick / 2
+  x += (left + right) / 2 * cos(middle heading), y += (left + right) / 2 * sin(middle heading)
+*/
+void Odometry::update() {
+  PROBE(PROBE_ODOMETRY);
+  unsigned long now = micros();
+  unsigned long elapsed = now - lastRun;   //the gyro is integrated over the time that really passed
+  lastRun = now;
+
+  long ticks[2];
+  encoders.delta(mark, ticks);
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    if (stepEngine.direction(wheel) < 0) {
+      ticks[wheel] = -ticks[wheel];
+    }
+  }
+  fix16 left = fixMul(fixFromInt(ticks[LEFT]), drive.cmPerTick);
+  fix16 right = fixMul(fixFromInt(ticks[RIGHT]), drive.cmPerTick);
+
+  fix16 previous = current.heading;
+  if (readGyro) {
+    readGyro(&gyroRaw);  //keeps the last reading if no new sample came in
+    if (ticks[LEFT] != 0 || ticks[RIGHT] != 0 || stepEngine.isRunning()) {
+      still = 0;
+    } else if (still < GYRO_STILL_PERIODS) {
+      still++;
+    } else {
+      gyroBias += fixMul(gyroRaw - gyroBias, GYRO_BIAS_WEIGHT);   //standing still, the whole reading is bias
+    }
+    gyroRate = gyroRaw - gyroBias;
+    if (elapsed > MAX_DT_US) {
+      elapsed = MAX_DT_US;
+    }
+    fix16 dt = (elapsed * 2147UL) >> 15;   //us to s in Q16.16 (2147 / 32768 = 65536 / 1000000)
+    fix16 turned = fixMul(gyroRate, dt);
+    gyroAngle = fixWrapDegrees(gyroAngle + turned);
+    current.heading = fixWrapDegrees(current.heading + turned);
+  } else {
+    fix16 turn = fixMul(fixFromInt(ticks[RIGHT] - ticks[LEFT]), drive.degreesPerTick) / 2;
+    current.heading = fixWrapDegrees(current.heading + turn);
+  }
+
+  fix16 sine, cosine;
+  fixSinCos(previous + fixWrapDegrees(current.heading - previous) / 2, &sine, &cosine);
+  fix16 distance = (left + right) / 2;
+  current.x += fixMul(distance, cosine);
+  current.y += fixMul(distance, sine);
+}
+
+//function to return the current pose
+Pose Odometry::pose() {
+  return current;
+}
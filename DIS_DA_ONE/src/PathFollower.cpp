@@ -0,0 +1,123 @@
+/*
+  PathFollower.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Pure pursuit to a goal point, see PathFollower.h. The wheels run in the step engine's speed mode and every period
+  gets new speeds, limited to PURSUIT_ACCEL so the steppers never get a speed jump they cannot follow.
+  All of it is Q16.16: speeds in steps/s, distances in cm, angles in degrees.
+*/
+
+#include "PathFollower.h"
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include "Odometry.h"
+
+#define MAX_CHANGE toFix(PURSUIT_ACCEL * (PURSUIT_PERIOD_US / 1000000.0))   //steps/s a wheel may change per period
+#define SPIN_GAIN toFix(2.0)                                                  //1/s, turn in place rate per degree off
+
+PathFollower pathFollower;
+
+//function to load the default tolerance
+void PathFollower::begin() {
+  tolerance = PURSUIT_TOLERANCE;
+  running = false;
+}
+
+//function to set how close to the goal (cm) ends a SEG_GOAL segment
+void PathFollower::setTolerance(fix16 cm) {
+  tolerance = cm;
+}
+
+//function to start driving to the goal of a segment, the top speed is the segment's right wheel speed
+void PathFollower::start(const MotionSegment &segment) {
+  goal[0] = segment.goal[0];
+  goal[1] = segment.goal[1];
+  cruise = (fix16)(segment.speed[RIGHT] * FIX_ONE);
+  wheelSpeed[RIGHT] = 0;
+  wheelSpeed[LEFT] = 0;
+  running = true;
+}
+
+/*
+  One pursuit period.
+  angle = bearing of the goal - heading, distance = distance to the goal
+  angle more than PURSUIT_SPIN_ANGLE: turn in place toward the goal
+  otherwise: v = distance * PURSUIT_SLOWDOWN (PURSUIT_MIN_SPEED to cruise), wheels = v (1 +- sin(angle) * track / distance)
+*/
+void PathFollower::update() {
+  if (!running) {
+    return;
+  }
+
+  Pose here = odometry.pose();
+  fix16 bearing, distance;
+  fixPolar(goal[0] - here.x, goal[1] - here.y, &bearing, &distance);
+  fix16 angle = fixWrapDegrees(bearing - here.heading);
+  fix16 offBy = angle >= 0 ? angle : -angle;
+  if (distance <= tolerance || (offBy > toFix(90) && distance < 3 * tolerance)) {
+    stop();   //there, or just past it and within reach (turning back would only circle the goal)
+    return;
+  }
+
+  if (offBy > PURSUIT_SPIN_ANGLE) {
+    fix16 turn = fixMul(fixMul(offBy, drive.stepsPerDegree), SPIN_GAIN);
+    if (turn > cruise) {
+      turn = cruise;
+    }
+    if (angle < 0) {
+      turn = -turn;   //clockwise
+    }
+    setWheels(turn, -turn);
+    return;
+  }
+
+  fix16 speed = fixMul(fixMul(distance, drive.stepsPerCm), PURSUIT_SLOWDOWN);
+  if (speed > cruise) {
+    speed = cruise;
+  }
+  if (speed < PURSUIT_MIN_SPEED) {
+    speed = PURSUIT_MIN_SPEED;
+  }
+  fix16 sine, cosine;
+  fixSinCos(angle, &sine, &cosine);
+  //curvature * track / 2 = sin(angle) * track / distance, distance is at least the tolerance so >> 8 keeps it nonzero
+  fix16 spread = (fixMul(sine, drive.trackWidth) << 8) / (distance >> 8);
+  if (spread > FIX_ONE) {
+    spread = FIX_ONE;   //tighter than a pivot on the inside wheel, hold the pivot
+  } else if (spread < -FIX_ONE) {
+    spread = -FIX_ONE;
+  }
+  fix16 difference = fixMul(speed, spread);
+  setWheels(speed + difference, speed - difference);
+}
+
+//function to move each wheel speed toward its new value by at most MAX_CHANGE and hand it to the step engine
+void PathFollower::setWheels(fix16 right, fix16 left) {
+  fix16 wanted[2];
+  wanted[RIGHT] = right;
+  wanted[LEFT] = left;
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    fix16 change = wanted[wheel] - wheelSpeed[wheel];
+    if (change > MAX_CHANGE) {
+      change = MAX_CHANGE;
+    } else if (change < -MAX_CHANGE) {
+      change = -MAX_CHANGE;
+    }
+    wheelSpeed[wheel] += change;
+    stepEngine.setSpeed(wheel, wheelSpeed[wheel] * (1.0 / FIX_ONE));
+  }
+}
+
+//function to stop following, the wheels are already slow at the goal so they stop on their next step
+void PathFollower::stop() {
+  running = false;
+  wheelSpeed[RIGHT] = 0;
+  wheelSpeed[LEFT] = 0;
+  stepEngine.stop(RIGHT);
+  stepEngine.stop(LEFT);
+}
+
+//function to tell if the follower is still driving to its goal
+bool PathFollower::active() {
+  return running;
+}
@@ -0,0 +1,60 @@
+/*
+  Probes.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Timing probe table and its report, see Probes.h.
+*/
+
+#include "Probes.h"
+
+#if TIMING_PROBES
+
+#include <util/atomic.h>
+
+ProbeStat probeTable[PROBE_COUNT];
+
+//probe names in ProbeId order, kept in flash
+static const char probeNames[PROBE_COUNT][10] PROGMEM = {
+  "forward", "reverse", "spin", "turn", "pivot", "circle", "goal", "runToStop", "queue", "odometry",
+  "enc right", "enc left", "serial", "bluetooth", "telemetry"
+};
+
+//function to start the cycle counter the probes read
+void probesBegin() {
+  cycleCounterBegin();
+}
+
+/*
+  Prints every probe that ran since the last call, one line each: calls, then min, average, max and total time in
+  microseconds, and clears the table. Each entry is copied with interrupts off, the ISR probes keep counting meanwhile.
+*/
+void probesPrint(Print &port) {
+  port.println("probe\tcalls\tmin\tavg\tmax\ttotal (us)");
+  for (uint8_t id = 0; id < PROBE_COUNT; id++) {
+    ProbeStat stat;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      stat = probeTable[id];
+      probeTable[id].count = 0;
+      probeTable[id].total = 0;
+      probeTable[id].max = 0;
+    }
+    if (stat.count == 0) {
+      continue;
+    }
+    char name[sizeof(probeNames[0])];
+    strcpy_P(name, probeNames[id]);
+    port.print(name);
+    port.print('\t');
+    port.print(stat.count);
+    port.print('\t');
+    port.print(stat.min / (float)CYCLES_PER_US, 1);
+    port.print('\t');
+    port.print(stat.total / (float)CYCLES_PER_US / stat.count, 1);
+    port.print('\t');
+    port.print(stat.max / (float)CYCLES_PER_US, 1);
+    port.print('\t');
+    port.println(stat.total / CYCLES_PER_US);
+  }
+}
+
+#endif
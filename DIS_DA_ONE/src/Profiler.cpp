@@ -0,0 +1,189 @@
+/*
+  Profiler.cpp
+  Kyzer Bowen, Tyce Miller
+
+  ISR and loop() statistics and the startup step rate sweep, see Profiler.h.
+  Only built with -D PROFILE_BENCHMARK.
+*/
+
+#ifdef PROFILE_BENCHMARK
+
+#include "Profiler.h"
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include <util/atomic.h>
+
+ProfileStat profileIsrTime[PROFILE_SLOTS];
+ProfileStat profileLatency[2];
+volatile uint16_t profileLate[2];
+
+static uint32_t loopHistogram[PROFILE_LOOP_BUCKETS]; //passes through loop() by time bucket
+static uint32_t loopMax = 0;                         //longest pass in cycles
+static uint32_t loopStamp = 0;                       //cycleCount() at the start of this pass, 0 before the first
+static uint32_t reportStamp = 0;                     //cycleCount() of the last report
+
+static const char *const slotName[PROFILE_SLOTS] = {"step right", "step left", "encoder right", "encoder left"};
+
+//function to start the cycle counter and clear the statistics
+void profileBegin() {
+  cycleCounterBegin();
+  profileClear();
+  reportStamp = cycleCount();
+}
+
+//function to start every statistic over
+void profileClear() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(profileIsrTime, 0, sizeof(profileIsrTime));
+    memset(profileLatency, 0, sizeof(profileLatency));
+    profileLate[RIGHT] = 0;
+    profileLate[LEFT] = 0;
+  }
+  memset(loopHistogram, 0, sizeof(loopHistogram));
+  loopMax = 0;
+  loopStamp = 0;
+}
+
+//function to print one statistic line, count min avg max in cycles
+static void print_stat(const char *name, const ProfileStat &stat) {
+  Serial.print(name);
+  Serial.print("\tcount: ");
+  Serial.print(stat.count);
+  Serial.print("\tmin: ");
+  Serial.print(stat.min);
+  Serial.print("\tavg: ");
+  Serial.print(stat.count ? stat.total / stat.count : 0);
+  Serial.print("\tmax: ");
+  Serial.println(stat.max);
+}
+
+//function to print the ISR and loop() statistics gathered since the last report
+static void print_report(uint32_t elapsed) {
+  ProfileStat isrTime[PROFILE_SLOTS];
+  ProfileStat latency[2];
+  uint16_t late[2];
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  //copy first, the ISRs keep adding while this prints
+    memcpy(isrTime, profileIsrTime, sizeof(isrTime));
+    memcpy(latency, profileLatency, sizeof(latency));
+    late[RIGHT] = profileLate[RIGHT];
+    late[LEFT] = profileLate[LEFT];
+  }
+
+  Serial.print("Profile over ");
+  Serial.print(elapsed / CYCLES_PER_MS);
+  Serial.println(" ms (CPU cycles)");
+  for (uint8_t slot = 0; slot < PROFILE_SLOTS; slot++) {
+    print_stat(slotName[slot], isrTime[slot]);
+  }
+  print_stat("latency right", latency[PROFILE_STEP_RIGHT]);
+  print_stat("latency left", latency[PROFILE_STEP_LEFT]);
+  Serial.print("late steps\tright: ");
+  Serial.print(late[RIGHT]);
+  Serial.print("\tleft: ");
+  Serial.println(late[LEFT]);
+
+  Serial.print("loop() max: ");
+  Serial.println(loopMax);
+  uint32_t bucketTop = 256;
+  for (uint8_t bucket = 0; bucket < PROFILE_LOOP_BUCKETS; bucket++) {
+    if (loopHistogram[bucket]) {
+      Serial.print(bucket == PROFILE_LOOP_BUCKETS - 1 ? "  more\t" : "  < ");
+      if (bucket < PROFILE_LOOP_BUCKETS - 1) {
+        Serial.print(bucketTop);
+        Serial.print("\t");
+      }
+      Serial.println(loopHistogram[bucket]);
+    }
+    bucketTop <<= 1;
+  }
+}
+
+/*
+  Times one pass through loop(), from the last call to this one. The report is printed from here when it is due,
+  and the pass that printed it is left out of the histogram.
+*/
+void profileLoop() {
+  uint32_t now = cycleCount();
+  if (loopStamp) {
+    uint32_t pass = now - loopStamp;
+    uint8_t bucket = 0;
+    for (uint32_t top = 256; pass >= top && bucket < PROFILE_LOOP_BUCKETS - 1; top <<= 1) {
+      bucket++;
+    }
+    loopHistogram[bucket]++;
+    if (pass > loopMax) {
+      loopMax = pass;
+    }
+  }
+  loopStamp = now;
+
+  if (now - reportStamp >= PROFILE_REPORT_MS * CYCLES_PER_MS) {
+    print_report(now - reportStamp);
+    profileClear();
+    reportStamp = cycleCount();
+    loopStamp = reportStamp;
+  }
+}
+
+/*
+  Runs both wheels in speed mode at PROFILE_RATE_STEP, 2 * PROFILE_RATE_STEP ... PROFILE_RATE_MAX steps/s with the
+  stepper drivers turned off, so the robot does not move, and prints what each wheel really made, the late steps and
+  how much of the CPU the step ISRs took. The sustained rate of a wheel is the highest one it made within 1% with no
+  late step. Positions are put back to 0 at the end.
+*/
+void benchmark_step_rate() {
+  uint16_t sustained[2] = {0, 0};
+  Serial.println("Step rate benchmark, drivers off (steps/s)");
+  digitalWrite(stepperEnable, stepperEnFalse);
+
+  for (uint16_t rate = PROFILE_RATE_STEP; rate <= PROFILE_RATE_MAX; rate += PROFILE_RATE_STEP) {
+    stepEngine.setSpeed(RIGHT, rate);
+    stepEngine.setSpeed(LEFT, rate);
+    delay(PROFILE_WINDOW_MS / 5);   //the first step of a new rate lands
+    long start[2] = {stepEngine.currentPosition(RIGHT), stepEngine.currentPosition(LEFT)};
+    profileClear();
+    uint32_t begin = cycleCount();
+    delay(PROFILE_WINDOW_MS);
+    uint32_t elapsed = cycleCount() - begin;
+    long steps[2] = {stepEngine.currentPosition(RIGHT) - start[RIGHT], stepEngine.currentPosition(LEFT) - start[LEFT]};
+
+    uint32_t isrCycles = 0;
+    uint16_t late[2];
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      isrCycles = profileIsrTime[PROFILE_STEP_RIGHT].total + profileIsrTime[PROFILE_STEP_LEFT].total;
+      late[RIGHT] = profileLate[RIGHT];
+      late[LEFT] = profileLate[LEFT];
+    }
+
+    Serial.print("asked: ");
+    Serial.print(rate);
+    for (uint8_t wheel = 0; wheel < 2; wheel++) {
+      float made = steps[wheel] * (float)F_CPU / elapsed;
+      Serial.print(wheel == RIGHT ? "\tright: " : "\tleft: ");
+      Serial.print(made, 0);
+      Serial.print(" late: ");
+      Serial.print(late[wheel]);
+      if (made >= rate * 0.99 && late[wheel] == 0 && sustained[wheel] == rate - PROFILE_RATE_STEP) {
+        sustained[wheel] = rate;
+      }
+    }
+    Serial.print("\tISR load: ");
+    Serial.print(100.0 * isrCycles / elapsed, 1);
+    Serial.println("%");
+  }
+
+  stepEngine.setSpeed(RIGHT, 0);
+  stepEngine.setSpeed(LEFT, 0);
+  delay(PROFILE_WINDOW_MS / 5);
+  stepEngine.setCurrentPosition(RIGHT, 0);
+  stepEngine.setCurrentPosition(LEFT, 0);
+  digitalWrite(stepperEnable, stepperEnTrue);
+  profileClear();
+
+  Serial.print("Sustained step rate\tright: ");
+  Serial.print(sustained[RIGHT]);
+  Serial.print("\tleft: ");
+  Serial.println(sustained[LEFT]);
+}
+
+#endif
@@ -0,0 +1,91 @@
+/*
+  Scheduler.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Fixed rate cooperative task scheduler, see Scheduler.h.
+  Run times come from the Timer5 cycle counter (CycleCounter.h), the due times from micros() so a period can be
+  longer than the 268 s the cycle count takes to wrap.
+*/
+
+#include "Scheduler.h"
+#include "CycleCounter.h"
+
+Scheduler scheduler;
+
+//function to take the task table, every task runs on the first pass and its periods count from there
+void Scheduler::begin(const Task *table, uint8_t count) {
+  cycleCounterBegin();
+  tasks = table;
+  taskCount = min(count, (uint8_t)SCHEDULER_MAX_TASKS);
+  unsigned long now = micros();
+  for (uint8_t task = 0; task < taskCount; task++) {
+    due[task] = now;
+    running[task] = false;
+    memset(&stats[task], 0, sizeof(stats[task]));
+  }
+}
+
+/*
+  One pass down the table.
+  late = now - due, the task is not due yet while that is negative (compared signed so micros() can wrap)
+  late < period: due += period, late >= period: missed, due = now + period
+*/
+void Scheduler::run() {
+  for (uint8_t task = 0; task < taskCount; task++) {
+    if (running[task]) {
+      continue;   //a blocking move inside this task is waiting on us
+    }
+    const Task &entry = tasks[task];
+    TaskStat &stat = stats[task];
+    if (entry.period) {
+      unsigned long now = micros();
+      long late = (long)(now - due[task]);
+      if (late < 0) {
+        continue;
+      }
+      if ((unsigned long)late >= entry.period) {
+        stat.misses++;
+        due[task] = now + entry.period;
+      } else {
+        due[task] += entry.period;
+      }
+      if ((unsigned long)late > stat.late) {
+        stat.late = late;
+      }
+    }
+
+    running[task] = true;
+    uint32_t start = cycleCount();
+    entry.run();
+    uint32_t cycles = cycleCount() - start;
+    running[task] = false;
+
+    stat.runs++;
+    stat.total += cycles;
+    if (cycles > stat.max) {
+      stat.max = cycles;
+    }
+  }
+}
+
+//function to print each task's period, runs, missed deadlines, average and longest run and worst lateness, then clear them
+void Scheduler::print(Print &port) {
+  port.println("task\tperiod\truns\tmissed\tavg\tmax\tlate (us)");
+  for (uint8_t task = 0; task < taskCount; task++) {
+    TaskStat &stat = stats[task];
+    port.print(tasks[task].name);
+    port.print('\t');
+    port.print(tasks[task].period);
+    port.print('\t');
+    port.print(stat.runs);
+    port.print('\t');
+    port.print(stat.misses);
+    port.print('\t');
+    port.print(stat.runs ? stat.total / (float)CYCLES_PER_US / stat.runs : 0, 1);
+    port.print('\t');
+    port.print(stat.max / (float)CYCLES_PER_US, 1);
+    port.print('\t');
+    port.println(stat.late);
+    memset(&stat, 0, sizeof(stat));
+  }
+}
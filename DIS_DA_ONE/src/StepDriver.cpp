@@ -0,0 +1,34 @@
+/*
+  StepDriver.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Step callbacks for the AccelStepper FUNCTION interface, so the AccelStepper and MultiStepper demos step the
+  wheels through the PORTB driver instead of digitalWrite().
+  http://www.airspayce.com/mikem/arduino/AccelStepper/classAccelStepper.html
+*/
+
+#include "StepDriver.h"
+
+//function to step the right wheel forward one step
+void rightStepForward() {
+  setDirBits(RT_DIR_BIT, RT_DIR_BIT);
+  stepPulse(RT_STEP_BIT);
+}
+
+//function to step the right wheel backward one step
+void rightStepBackward() {
+  setDirBits(RT_DIR_BIT, 0);
+  stepPulse(RT_STEP_BIT);
+}
+
+//function to step the left wheel forward one step
+void leftStepForward() {
+  setDirBits(LT_DIR_BIT, LT_DIR_BIT);
+  stepPulse(LT_STEP_BIT);
+}
+
+//function to step the left wheel backward one step
+void leftStepBackward() {
+  setDirBits(LT_DIR_BIT, 0);
+  stepPulse(LT_STEP_BIT);
+}
@@ -0,0 +1,928 @@
+/*
+  StepEngine.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Timer1 output compare step generation for the two wheel steppers.
+  Each step the compare ISR works out the interval to the next one and schedules it, so a step is emitted at its
+  scheduled time no matter what the main loop is doing.
+
+  The ramp is jerk limited (an S-curve): the acceleration itself ramps up and down at the jerk rate, so there is no
+  step change in acceleration for the tires to slip on. With the jerk set to 0 the acceleration jumps straight to
+  its limit and the ramp is the same constant acceleration trapezoid AccelStepper makes. Each step the ISR adds the
+  jerk and acceleration over the interval it just waited (v += a dt, a += j dt) and eases the acceleration back to 0
+  early enough to land on the target speed (the speed still gained while a ramps to 0 is a^2 / 2j). Where to start
+  braking is planned in the foreground when the move starts, a ramp from v1 to v2 takes (v1 + v2) / 2 * T steps with
+  T = dv / a + a / j, or 2 sqrt(dv / j) when the acceleration limit is never reached.
+
+  The ISR side is integer only and costs about the same every step: speeds are steps/s * 256, accelerations are in
+  units that turn a speed change into a multiply and a shift, and the interval for a speed is looked up in a table
+  of 1 / speed built at compile time and kept in flash (rampTable), instead of the float divisions and square
+  roots of AccelStepper::computeNewSpeed(). The table is normalized, so it works for any acceleration and jerk set
+  at run time.
+
+  Linked moves (moveLinked) run one ramp for the whole path on compare A instead. Every path step the wheel with more
+  steps (the major wheel) steps, and a Bresenham error term decides whether the other wheel steps too, so the ratio
+  between the wheels is exact at every instant of the ramp and not just at the end.
+
+  Timer1 is taken over completely, so analogWrite() on pins 11 and 12 is not available while the engine runs.
+  https://playground.arduino.cc/code/timer1
+  http://www.airspayce.com/mikem/arduino/AccelStepper/
+*/
+
+#include "StepEngine.h"
+#include "RobotConfig.h"
+#include "StepDriver.h"
+#include "Profiler.h"
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+
+#define MODE_IDLE 0       //wheel is stopped, compare interrupt disabled
+#define MODE_POSITION 1   //accelerate/decelerate to target
+#define MODE_SPEED 2      //run at a constant speed until told otherwise
+#define MODE_LINKED 3     //stepped by the path DDA on compare A (moveLinked)
+
+#define MAX_INTERVAL 0x3FFFFFFFUL   //longest interval (ticks * 256) that keeps the ramp math inside a long
+#define TICKS_PER_SECOND ((float)STEP_TIMER_HZ * 256.0)   //units of the step intervals per second
+#define SPEED_ONE 256.0             //ISR speeds are steps/s * 256
+#define ACCEL_ONE 268.435456        //ISR accelerations are steps/s^2 * 2^28 / 10^6, (accel >> 8) * ticks >> 13 is the speed change
+#define JERK_ONE (ACCEL_ONE / STEP_TIMER_HZ * 256.0)   //ISR jerk, jerk * ticks >> 8 is the acceleration change
+
+/*
+  1 / speed table for the step intervals, built by the compiler.
+  inverse[i] = 2^24 / (256 + i), the reciprocal of a speed normalized to 256 - 512 (the first entry, 65536, is
+  stored as 65535). intervalAt() shifts a speed into that range, interpolates between two entries and shifts back.
+*/
+struct RampTable {
+  uint16_t inverse[257];
+};
+
+template <unsigned... I> struct RampIndex {};
+template <unsigned N, unsigned... I> struct MakeRampIndex : MakeRampIndex<N - 1, N - 1, I...> {};
+template <unsigned... I> struct MakeRampIndex<0, I...> {
+  typedef RampIndex<I...> type;
+};
+
+constexpr uint16_t inverseEntry(unsigned i) {
+  return i == 0 ? 0xFFFF : (uint16_t)((0x1000000UL + (256 + i) / 2) / (256 + i));
+}
+
+template <unsigned... I> constexpr RampTable buildRampTable(RampIndex<I...>) {
+  return RampTable{{inverseEntry(I)...}};
+}
+
+static const RampTable rampTable PROGMEM = buildRampTable(MakeRampIndex<257>::type());
+
+//state for one wheel, shared between the foreground and the compare ISR
+struct StepAxis {
+  volatile long position;           //current position in steps
+  volatile long target;             //target position in steps (position mode)
+  volatile uint32_t cn;             //current step interval in timer ticks * 256
+  volatile uint32_t pending;        //ticks still to wait when an interval does not fit in 16 bits
+  volatile uint32_t speedInterval;  //constant step interval for speed mode (ticks * 256), 0 to stop
+  volatile int8_t speedDir;         //requested direction for speed mode
+  volatile int8_t dir;              //direction of the next step, 1 forward, -1 backward
+  volatile uint8_t mode;            //MODE_IDLE, MODE_POSITION or MODE_SPEED
+  volatile uint32_t v;              //speed (steps/s * 256), 0 at rest
+  volatile long accel;              //acceleration (ACCEL_ONE units), positive speeds up
+  volatile uint32_t cruise;         //top speed planned for the move (steps/s * 256)
+  volatile uint32_t exitSpeed;      //speed at the target, the junction speed of a chained move
+  volatile long brakeSteps;         //steps before the target where braking to exitSpeed starts
+  volatile long nextTarget;         //target of the move chained after this one
+  volatile uint32_t nextCmin;       //step interval at max speed for the chained move
+  volatile uint32_t nextCruise;     //cruise of the chained move
+  volatile long nextBrake;          //brakeSteps of the chained move (it ends stopped until something is chained after it)
+  volatile bool hasNext;            //a chained move is waiting
+  uint32_t cmin;                    //step interval at max speed (ticks * 256)
+  float acceleration;               //steps/s^2, kept to plan the ramps
+  float jerk;                       //steps/s^3, 0 for the constant acceleration ramp
+  long maxAccel;                    //acceleration limit (ACCEL_ONE units)
+  long jerkStep;                    //jerk (JERK_ONE units), 0 for the constant acceleration ramp
+  uint32_t easeFactor;              //easing starts once (accel >> 8)^2 >= speed still to go * easeFactor
+  uint32_t easeLimit;               //speed still to go beyond which there is no need to check
+  uint32_t s0;                      //first step interval from rest (ticks * 256)
+  uint32_t startSpeed;              //speed after the first step, also the slowest speed of the ramp
+  long startAccel;                  //acceleration after the first step
+  uint8_t stepMask;                 //PORTB bit of the step pin on the A4988
+  uint8_t dirMask;                  //PORTB bit of the direction pin on the A4988
+};
+
+//wheel steps of one linked move
+struct LinkedMove {
+  long steps[2];          //steps each wheel makes (magnitude), indexed by RIGHT and LEFT
+  int8_t dir[2];          //direction of each wheel
+  long major;             //path steps, the larger of the two
+};
+
+StepEngine stepEngine;
+static StepAxis axis[2];   //indexed by RIGHT and LEFT
+static StepAxis path;      //ramp of a linked move, position counts path steps (no pins of its own)
+static LinkedMove link;    //wheel steps of the linked move being run
+static LinkedMove nextLink;           //wheel steps of the chained linked move
+static long ddaError[2];              //Bresenham error of each wheel
+static volatile bool linked = false;  //compare A runs the path instead of the right wheel
+
+//function to set the direction pin for the next step
+static inline void setDirection(StepAxis &a, int8_t dir) {
+  a.dir = dir;
+  setDirBits(a.dirMask, dir > 0 ? a.dirMask : 0); //high means forward, same as AccelStepper
+}
+
+//function to look up the step interval (ticks * 256) for a speed (steps/s * 256), 1.31072e11 / speed
+static uint32_t intervalAt(uint32_t speed) {
+  if (speed < 256) {
+    speed = 256;   //1 step/s
+  }
+  int8_t shift = 0;   //normalize to 2^15 - 2^16
+  while (speed >= 0x10000UL) {
+    speed >>= 1;
+    shift++;
+  }
+  while (speed < 0x8000UL) {
+    speed <<= 1;
+    shift--;
+  }
+  uint8_t index = (speed >> 7) - 256;
+  uint8_t fraction = speed & 0x7F;
+  uint16_t high = pgm_read_word(&rampTable.inverse[index]);
+  uint16_t low = pgm_read_word(&rampTable.inverse[index + 1]);
+  uint32_t inverse = high - (((uint32_t)(high - low) * fraction) >> 7);   //2^31 / normalized speed
+  return (15625UL * inverse) >> (8 + shift);                               //1.31072e11 / 2^31 = 15625 / 256
+}
+
+/*
+  Works out the interval to the next step in position mode, 0 when the target has been reached.
+  The speed heads for cruise, or for exitSpeed once the target is brakeSteps away, or for 0 when the target is
+  behind (the wheel turns around at the slowest speed).
+*/
+static uint32_t rampInterval(StepAxis &a) {
+  if (a.hasNext && a.position == a.target) {  //carry on into the chained move at the junction speed
+    a.target = a.nextTarget;
+    a.cmin = a.nextCmin;
+    a.cruise = a.nextCruise;
+    a.brakeSteps = a.nextBrake;
+    a.exitSpeed = 0;
+    a.hasNext = false;
+  }
+  long distanceTo = a.target - a.position;
+  if (distanceTo == 0) {  //at the target, also where a junction with nothing chained after it stops
+    a.v = 0;
+    a.accel = 0;
+    return 0;
+  }
+  int8_t wanted = distanceTo > 0 ? 1 : -1;
+  if (a.v == 0) {  //first step from rest
+    setDirection(a, wanted);
+    a.v = a.startSpeed;
+    a.accel = a.startAccel;
+    a.cn = intervalAt(a.startSpeed);  //the interval the next one is worked out from
+    return a.s0;
+  }
+
+  uint32_t goal = a.cruise;
+  if (wanted != a.dir) {
+    goal = 0;   //target is behind, slow down and come back
+    if (a.v <= a.startSpeed) {
+      setDirection(a, wanted);
+      a.accel = 0;
+      goal = a.cruise;
+    }
+  } else if ((distanceTo >= 0 ? distanceTo : -distanceTo) <= a.brakeSteps) {
+    goal = a.exitSpeed;
+  }
+
+  uint32_t ticks = a.cn >> 8;   //the last interval, close to the one coming up
+  if (ticks > 0xFFFFUL) {
+    ticks = 0xFFFFUL;
+  }
+  uint32_t v = a.v;
+  long accel = a.accel;
+  uint32_t next = v;
+  if (v != goal) {
+    bool rising = v < goal;
+    long nextAccel;
+    bool easing = false;
+    if (a.jerkStep == 0) {
+      nextAccel = rising ? a.maxAccel : -a.maxAccel;
+    } else {
+      //ease off when ramping the acceleration to 0 from here gains (or loses) the rest of the speed
+      uint32_t gap = rising ? goal - v : v - goal;
+      long unit = accel >> 8;
+      easing = (rising ? unit > 0 : unit < 0) && gap < a.easeLimit && (uint32_t)(unit * unit) >= gap * a.easeFactor;
+      long change = (a.jerkStep * (long)ticks) >> 8;
+      nextAccel = accel + ((rising != easing) ? change : -change);
+      if (nextAccel > a.maxAccel) {
+        nextAccel = a.maxAccel;
+      } else if (nextAccel < -a.maxAccel) {
+        nextAccel = -a.maxAccel;
+      }
+    }
+    long change = (((accel + nextAccel) >> 9) * (long)ticks) >> 13;   //average acceleration over the interval
+    next = change >= 0 || (uint32_t)-change < v ? v + change : 0;
+    accel = nextAccel;
+    if (rising ? (next >= goal || (easing && accel <= 0)) : (next <= goal || (easing && accel >= 0))) {
+      next = goal;   //acceleration is back to 0 (or the speed got there first), hold the goal
+      accel = 0;
+    }
+  }
+  if (next < a.startSpeed) {
+    next = a.startSpeed;   //never slower than the first step, so the last steps to the target do not crawl
+    accel = 0;
+  }
+  a.v = next;
+  a.accel = accel;
+  a.cn = intervalAt((v + next) >> 1);   //at the average speed over the interval
+  if (a.cn < a.cmin) {
+    a.cn = a.cmin;
+  }
+  return a.cn;
+}
+
+//works out the interval to the next step in speed mode, 0 when the wheel has been told to stop
+static uint32_t speedModeInterval(StepAxis &a) {
+  if (a.speedInterval == 0) {
+    return 0;
+  }
+  if (a.speedDir != a.dir) {
+    setDirection(a, a.speedDir);
+  }
+  return a.speedInterval;
+}
+
+static inline uint32_t nextInterval(StepAxis &a) {
+  return a.mode == MODE_SPEED ? speedModeInterval(a) : rampInterval(a);
+}
+
+//function to program the compare register for the next step
+static inline void schedule(StepAxis &a, volatile uint16_t &ocr, uint32_t interval) {
+  uint32_t ticks = interval >> 8;
+  if (ticks < STEP_MIN_INTERVAL) {
+    ticks = STEP_MIN_INTERVAL;
+  }
+  if (ticks > 0x7FFFUL) {  //too long for the late check below, wait it out in pieces of at most 0x8000 ticks
+    a.pending = ticks - 0x4000;
+    ticks = 0x4000;
+  }
+  uint16_t next = ocr + (uint16_t)ticks;
+  if ((int16_t)(next - TCNT1) < 16) {  //ISR ran late, do not schedule into the past and wait a whole timer wrap
+    next = TCNT1 + 16;
+    PROFILE_STEP_LATE(&ocr == &OCR1A ? PROFILE_STEP_RIGHT : PROFILE_STEP_LEFT);
+  }
+  ocr = next;
+}
+
+//compare ISR body for one wheel, emits a step and schedules the next one
+static inline void serviceAxis(StepAxis &a, volatile uint16_t &ocr, uint8_t enableBit) {
+  if (a.pending) {  //still waiting out a long interval
+    uint16_t ticks = a.pending > 0x8000UL ? 0x8000 : (uint16_t)a.pending;
+    a.pending -= ticks;
+    ocr += ticks;
+    return;
+  }
+
+  stepPulse(a.stepMask);  //low to high transition makes the A4988 take a step
+  a.position += a.dir;
+  uint32_t interval = nextInterval(a);
+
+  if (interval == 0) {
+    TIMSK1 &= ~_BV(enableBit);  //no more steps, turn off this wheel's compare interrupt
+    a.mode = MODE_IDLE;
+    return;
+  }
+  schedule(a, ocr, interval);
+}
+
+//function to start the wheel steps of a linked move, the errors start half way so the minor steps are centered
+static void loadLink(const LinkedMove &move) {
+  link = move;
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    ddaError[wheel] = move.major / 2;
+    setDirection(axis[wheel], move.dir[wheel]);
+  }
+}
+
+//compare A ISR body during a linked move, one path step: the major wheel steps and the minor one when its error rolls over
+static inline void servicePath() {
+  if (path.pending) {
+    uint16_t ticks = path.pending > 0x8000UL ? 0x8000 : (uint16_t)path.pending;
+    path.pending -= ticks;
+    OCR1A += ticks;
+    return;
+  }
+
+  uint8_t mask = 0;
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    ddaError[wheel] += link.steps[wheel];
+    if (ddaError[wheel] >= link.major) {
+      ddaError[wheel] -= link.major;
+      mask |= axis[wheel].stepMask;
+      axis[wheel].position += axis[wheel].dir;
+    }
+  }
+  stepPulse(mask);  //both wheels step on the same edge
+  path.position++;
+
+  if (path.hasNext && path.position == path.target) {  //rampInterval() moves the path on, the wheels follow here
+    loadLink(nextLink);
+    for (uint8_t wheel = 0; wheel < 2; wheel++) {
+      axis[wheel].target += nextLink.dir[wheel] * nextLink.steps[wheel];
+    }
+  }
+  uint32_t interval = rampInterval(path);
+  if (interval == 0) {
+    TIMSK1 &= ~_BV(OCIE1A);
+    path.mode = MODE_IDLE;
+    linked = false;
+    for (uint8_t wheel = 0; wheel < 2; wheel++) {
+      axis[wheel].mode = MODE_IDLE;
+      axis[wheel].target = axis[wheel].position;
+    }
+    return;
+  }
+  schedule(path, OCR1A, interval);
+}
+
+ISR(TIMER1_COMPA_vect) {
+  PROFILE_ISR_BEGIN();
+  PROFILE_STEP_LATENCY(PROFILE_STEP_RIGHT, OCR1A);
+  if (linked) {
+    servicePath();
+  } else {
+    serviceAxis(axis[RIGHT], OCR1A, OCIE1A);
+  }
+  PROFILE_ISR_END(PROFILE_STEP_RIGHT);
+}
+
+ISR(TIMER1_COMPB_vect) {
+  PROFILE_ISR_BEGIN();
+  PROFILE_STEP_LATENCY(PROFILE_STEP_LEFT, OCR1B);
+  serviceAxis(axis[LEFT], OCR1B, OCIE1B);
+  PROFILE_ISR_END(PROFILE_STEP_LEFT);
+}
+
+//function to start an idle wheel, must be called with interrupts disabled
+static void arm(uint8_t wheel) {
+  StepAxis &a = axis[wheel];
+  a.v = 0;
+  a.pending = 0;
+  uint32_t interval = nextInterval(a);
+  if (interval == 0) {
+    a.mode = MODE_IDLE;
+    return;
+  }
+  uint8_t enableBit = wheel == RIGHT ? OCIE1A : OCIE1B;
+  volatile uint16_t &ocr = wheel == RIGHT ? OCR1A : OCR1B;
+  ocr = TCNT1;
+  schedule(a, ocr, interval);
+  TIFR1 = _BV(enableBit);    //clear a stale compare match (OCF1A/OCF1B share the OCIE1A/OCIE1B bit numbers)
+  TIMSK1 |= _BV(enableBit);  //turn on this wheel's compare interrupt
+}
+
+/*
+  Function to apply a new speed mode interval to a wheel that is already stepping, must be called with interrupts
+  disabled. The compare is set for the old interval, at a slow speed that can be most of a second (pending ticks
+  and all), so a faster speed or a stop waits that out first. Stopping turns the wheel off at once, a step due
+  later than the new interval would come is moved to one new interval from now.
+*/
+static void retime(uint8_t wheel) {
+  StepAxis &a = axis[wheel];
+  uint8_t enableBit = wheel == RIGHT ? OCIE1A : OCIE1B;
+  volatile uint16_t &ocr = wheel == RIGHT ? OCR1A : OCR1B;
+  uint32_t interval = speedModeInterval(a);
+  if (interval == 0) {
+    TIMSK1 &= ~_BV(enableBit);
+    a.mode = MODE_IDLE;
+    a.pending = 0;
+    return;
+  }
+  uint32_t waiting = a.pending + (uint16_t)(ocr - TCNT1);   //ticks to the next step as it is set now
+  if ((interval >> 8) >= waiting) {
+    return;   //the step already comes sooner, the ISR takes the new interval from there
+  }
+  a.pending = 0;
+  ocr = TCNT1;
+  schedule(a, ocr, interval);
+  TIFR1 = _BV(enableBit);    //a match that came while interrupts were off belongs to the old interval
+}
+
+//function to turn a speed in steps/s into the ISR's steps/s * 256
+static uint32_t toSpeed(float stepsPerSecond) {
+  return stepsPerSecond > 0 ? (uint32_t)(stepsPerSecond * SPEED_ONE) : 0;
+}
+
+//function to return the steps a ramp takes from one speed to another
+static float rampSteps(const StepAxis &a, float from, float to) {
+  float change = fabs(to - from);
+  if (a.jerk <= 0) {
+    return change * (from + to) / (2.0 * a.acceleration);
+  }
+  float time;
+  if (change >= a.acceleration * a.acceleration / a.jerk) {
+    time = change / a.acceleration + a.acceleration / a.jerk;  //jerk up, constant acceleration, jerk down
+  } else {
+    time = 2.0 * sqrt(change / a.jerk);                        //jerk up then straight back down
+  }
+  return (from + to) / 2.0 * time;   //the ramp is symmetric, the average speed is half way
+}
+
+/*
+  Plans a move of steps that starts at entry speed and ends at exit speed: the top speed it can reach (up to
+  maxSpeed) and the steps before the end where braking has to start. When maxSpeed does not fit in the steps the
+  top speed is found by bisection.
+*/
+static void planRamp(const StepAxis &a, long steps, float entry, float maxSpeed, float exit, uint32_t &cruise, long &brake) {
+  float top = maxSpeed;
+  if (rampSteps(a, entry, top) + rampSteps(a, top, exit) > steps) {
+    float low = max(entry, exit);
+    float high = maxSpeed;
+    for (uint8_t i = 0; i < 12; i++) {
+      top = (low + high) / 2.0;
+      if (rampSteps(a, entry, top) + rampSteps(a, top, exit) > steps) {
+        high = top;
+      } else {
+        low = top;
+      }
+    }
+    top = low;
+  }
+  cruise = toSpeed(top);
+  brake = (long)(rampSteps(a, top, exit) + 0.5);
+}
+
+//function to plan stopping from where a ramp is now, returns the steps it takes (at least 1)
+static long stopSteps(const StepAxis &a) {
+  float v, accel;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    v = a.v / SPEED_ONE;
+    accel = a.accel / ACCEL_ONE;
+  }
+  float steps = 0;
+  if (accel > 0 && a.jerk > 0) {  //still speeding up, the acceleration has to come back down to 0 first
+    float time = accel / a.jerk;
+    steps = time * (v + accel * time / 3.0);
+    v += accel * accel / (2.0 * a.jerk);
+  }
+  return (long)(steps + rampSteps(a, v, 0)) + 1;
+}
+
+//function to work out the ISR ramp settings and the first step from rest, which may reach the acceleration limit before it ends
+static void rampStart(StepAxis &a) {
+  float time, speed, accel;
+  float rampTime = a.jerk > 0 ? a.acceleration / a.jerk : 0;   //time to reach the acceleration limit
+  float rampDistance = a.jerk * rampTime * rampTime * rampTime / 6.0;
+  if (a.jerk > 0 && rampDistance >= 1.0) {
+    time = cbrt(6.0 / a.jerk);                             //1 step = j t^3 / 6
+    speed = a.jerk * time * time / 2.0;
+    accel = a.jerk * time;
+  } else {
+    float rampSpeed = a.jerk * rampTime * rampTime / 2.0;  //the rest of the step at constant acceleration
+    float extra = (sqrt(rampSpeed * rampSpeed + 2.0 * a.acceleration * (1.0 - rampDistance)) - rampSpeed) / a.acceleration;
+    time = rampTime + extra;
+    speed = rampSpeed + a.acceleration * extra;
+    accel = a.acceleration;
+  }
+  float ticks = time * TICKS_PER_SECOND;
+  float easeFactor = a.jerk * 2.0 * ACCEL_ONE * ACCEL_ONE / (65536.0 * SPEED_ONE);   //(accel >> 8)^2 per speed gained
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    a.s0 = ticks > MAX_INTERVAL ? MAX_INTERVAL : (uint32_t)ticks;
+    a.startSpeed = toSpeed(speed);
+    a.startAccel = (long)(accel * ACCEL_ONE);
+    a.maxAccel = (long)(a.acceleration * ACCEL_ONE);
+    a.jerkStep = (long)(a.jerk * JERK_ONE + 0.5);
+    a.easeFactor = easeFactor < 1.0 ? 1 : (uint32_t)(easeFactor + 0.5);
+    a.easeLimit = 0x40000000UL / a.easeFactor;   //(accel >> 8)^2 is below 2^30
+  }
+}
+
+//function to copy the ramp settings of a wheel to the path of a linked move
+static void copyProfile(StepAxis &to, const StepAxis &from) {
+  to.acceleration = from.acceleration;
+  to.jerk = from.jerk;
+  to.maxAccel = from.maxAccel;
+  to.jerkStep = from.jerkStep;
+  to.easeFactor = from.easeFactor;
+  to.easeLimit = from.easeLimit;
+  to.s0 = from.s0;
+  to.startSpeed = from.startSpeed;
+  to.startAccel = from.startAccel;
+}
+
+//function to set up the step and direction pins and start Timer1 free running at 2 MHz
+void StepEngine::begin() {
+  axis[RIGHT].stepMask = RT_STEP_BIT;
+  axis[RIGHT].dirMask = RT_DIR_BIT;
+  axis[LEFT].stepMask = LT_STEP_BIT;
+  axis[LEFT].dirMask = LT_DIR_BIT;
+  stepDriverBegin();
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    axis[wheel].mode = MODE_IDLE;
+    axis[wheel].dir = 1;
+    setDirection(axis[wheel], 1);
+  }
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    TCCR1A = 0;             //normal mode, output compare pins disconnected
+    TCCR1B = _BV(CS11);     //clk/8, 2 MHz timer ticks
+    TIMSK1 = 0;             //compare interrupts are turned on per wheel when it has steps to make
+  }
+}
+
+//function to move a wheel to an absolute position with acceleration (AccelStepper::moveTo())
+void StepEngine::moveTo(uint8_t wheel, long absolute) {
+  StepAxis &a = axis[wheel];
+  long steps;
+  float entry = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    steps = absolute - a.position;
+    if (a.mode != MODE_IDLE && (steps >= 0) == (a.dir > 0)) {
+      entry = a.v / SPEED_ONE;   //already moving the right way
+    }
+  }
+  uint32_t cruise;
+  long brake;
+  planRamp(a, labs(steps), entry, TICKS_PER_SECOND / a.cmin, 0, cruise, brake);   //outside the atomic block, it takes a while
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    a.target = absolute;
+    a.hasNext = false;
+    a.cruise = cruise;
+    a.brakeSteps = brake;
+    a.exitSpeed = 0;
+    if (a.mode == MODE_SPEED) {
+      a.accel = 0;   //keep the current speed and ramp from there
+      a.mode = MODE_POSITION;
+    } else if (a.mode == MODE_IDLE) {
+      a.mode = MODE_POSITION;
+      arm(wheel);
+    }
+  }
+}
+
+//function to move a wheel relative to its current position (AccelStepper::move())
+void StepEngine::move(uint8_t wheel, long relative) {
+  moveTo(wheel, currentPosition(wheel) + relative);
+}
+
+/*
+  Plans a junction: the steps before the junction where the move being made now starts braking to the junction
+  speed, and the top speed and braking steps of the chained move that starts at it.
+*/
+static void planJunction(const StepAxis &a, long steps, float maxSpeed, float junction, long &brake, uint32_t &nextCruise, long &nextBrake) {
+  brake = (long)(rampSteps(a, a.cruise / SPEED_ONE, junction) + 0.5);   //cruise only changes at a junction, none is waiting
+  planRamp(a, steps, junction, maxSpeed, 0, nextCruise, nextBrake);
+}
+
+/*
+  Chains a move of both wheels after the one they are making now, relative to their targets and indexed by RIGHT
+  and LEFT. The current moves no longer stop at their targets, each wheel slows down to its junction speed (steps/s)
+  and the ISR carries straight on into the chained move.
+  Both wheels are chained or neither: returns false if a wheel is not in the middle of a position move or already
+  has a chained move, then wait for the wheels to stop and use move() instead.
+*/
+bool StepEngine::chain(const long relative[2], const float maxSpeed[2], const float junctionSpeed[2]) {
+  uint32_t cmin[2];
+  long brake[2];
+  uint32_t cruise[2];
+  long nextBrake[2];
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    float speed = maxSpeed[wheel] > 1.0 ? maxSpeed[wheel] : 1.0;
+    float ticks = TICKS_PER_SECOND / speed;
+    cmin[wheel] = ticks > MAX_INTERVAL ? MAX_INTERVAL : (uint32_t)ticks;
+    planJunction(axis[wheel], labs(relative[wheel]), speed, junctionSpeed[wheel], brake[wheel], cruise[wheel], nextBrake[wheel]);
+  }
+  bool chained = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    StepAxis &right = axis[RIGHT];
+    StepAxis &left = axis[LEFT];
+    if (right.mode == MODE_POSITION && !right.hasNext && right.position != right.target &&
+        left.mode == MODE_POSITION && !left.hasNext && left.position != left.target) {
+      for (uint8_t wheel = 0; wheel < 2; wheel++) {
+        StepAxis &a = axis[wheel];
+        a.nextTarget = a.target + relative[wheel];
+        a.nextCmin = cmin[wheel];
+        a.exitSpeed = toSpeed(junctionSpeed[wheel]);
+        a.brakeSteps = brake[wheel];
+        a.nextCruise = cruise[wheel];
+        a.nextBrake = nextBrake[wheel];
+        a.hasNext = true;
+      }
+      chained = true;
+    }
+  }
+  return chained;
+}
+
+//function to fill in the wheel steps of a linked move, returns the path steps
+static long linkedMove(const long steps[2], LinkedMove &move) {
+  move.major = 0;
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    move.steps[wheel] = labs(steps[wheel]);
+    move.dir[wheel] = steps[wheel] >= 0 ? 1 : -1;
+    if (move.steps[wheel] > move.major) {
+      move.major = move.steps[wheel];
+    }
+  }
+  return move.major;
+}
+
+/*
+  Moves both wheels by relative steps (indexed by RIGHT and LEFT) as one coordinated move. maxSpeed and the ramp are
+  for the wheel with more steps, the other wheel keeps the exact step ratio the whole way through the ramp.
+  Both wheels have to be stopped, returns false otherwise. Until the move ends the wheels only take stop() and halt().
+*/
+bool StepEngine::moveLinked(const long steps[2], float maxSpeed) {
+  LinkedMove move;
+  if (linkedMove(steps, move) == 0) {
+    return true;   //nothing to do
+  }
+  float speed = maxSpeed > 1.0 ? maxSpeed : 1.0;
+  float ticks = TICKS_PER_SECOND / speed;
+  uint8_t major = move.steps[RIGHT] >= move.steps[LEFT] ? RIGHT : LEFT;
+  uint32_t cruise;
+  long brake;
+  planRamp(axis[major], move.major, 0, speed, 0, cruise, brake);
+  bool started = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (axis[RIGHT].mode == MODE_IDLE && axis[LEFT].mode == MODE_IDLE) {
+      path.position = 0;
+      path.target = move.major;
+      path.dir = 1;
+      path.hasNext = false;
+      path.cmin = ticks > MAX_INTERVAL ? MAX_INTERVAL : (uint32_t)ticks;
+      copyProfile(path, axis[major]);                //the path ramps like the major wheel would on its own
+      path.cruise = cruise;
+      path.brakeSteps = brake;
+      path.exitSpeed = 0;
+      path.mode = MODE_POSITION;
+      loadLink(move);
+      for (uint8_t wheel = 0; wheel < 2; wheel++) {
+        axis[wheel].target = axis[wheel].position + steps[wheel];
+        axis[wheel].mode = MODE_LINKED;
+      }
+      linked = true;
+      path.v = 0;
+      path.pending = 0;
+      OCR1A = TCNT1;
+      schedule(path, OCR1A, rampInterval(path));
+      TIFR1 = _BV(OCF1A);
+      TIMSK1 |= _BV(OCIE1A);
+      started = true;
+    }
+  }
+  return started;
+}
+
+/*
+  Chains a linked move behind the linked move running now, the path slows down to junctionSpeed (path steps/s) and
+  carries straight on with the new wheel steps. False if no linked move is running or one is already chained.
+*/
+bool StepEngine::chainLinked(const long steps[2], float maxSpeed, float junctionSpeed) {
+  LinkedMove move;
+  long major = linkedMove(steps, move);
+  float speed = maxSpeed > 1.0 ? maxSpeed : 1.0;
+  float ticks = TICKS_PER_SECOND / speed;
+  long brake = 0;
+  uint32_t cruise = 0;
+  long nextBrake = 0;
+  if (linked) {
+    planJunction(path, major, speed, junctionSpeed, brake, cruise, nextBrake);
+  }
+  bool chained = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (linked && major > 0 && !path.hasNext && path.position != path.target) {
+      nextLink = move;
+      path.nextTarget = path.target + major;
+      path.nextCmin = ticks > MAX_INTERVAL ? MAX_INTERVAL : (uint32_t)ticks;
+      path.exitSpeed = toSpeed(junctionSpeed);
+      path.brakeSteps = brake;
+      path.nextCruise = cruise;
+      path.nextBrake = nextBrake;
+      path.hasNext = true;
+      chained = true;
+    }
+  }
+  return chained;
+}
+
+//function to tell if a chained move is still waiting for the current move to reach its target
+bool StepEngine::chained(uint8_t wheel) {
+  return axis[wheel].mode == MODE_LINKED ? path.hasNext : axis[wheel].hasNext;
+}
+
+//function to run a wheel continuously at a signed speed in steps/s, 0 stops it (AccelStepper::runSpeed())
+void StepEngine::setSpeed(uint8_t wheel, float speed) {
+  StepAxis &a = axis[wheel];
+  float mag = speed >= 0 ? speed : -speed;
+  uint32_t interval = 0;
+  if (mag >= 1.0) {
+    float ticks = TICKS_PER_SECOND / mag;
+    interval = ticks > MAX_INTERVAL ? MAX_INTERVAL : (uint32_t)ticks;
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    a.speedInterval = interval;
+    a.speedDir = speed >= 0 ? 1 : -1;
+    a.cn = interval;
+    a.v = interval ? toSpeed(mag) : 0;   //a move from here starts at this speed
+    if (a.mode == MODE_POSITION) {
+      a.mode = MODE_SPEED;
+    } else if (a.mode == MODE_IDLE) {
+      a.mode = MODE_SPEED;
+      arm(wheel);
+    } else if (a.mode == MODE_SPEED) {
+      retime(wheel);
+    }
+  }
+}
+
+/*
+  Sets the maximum permitted speed in steps/s, a position move that is under way changes speed at once.
+  A lower limit only lowers cruise, the braking steps planned for the old cruise are more than enough.
+  A higher limit plans the rest of the move again from the speed the wheel has and the steps it has left, so the
+  braking steps grow with cruise. Inside the braking steps (or turning around) the move keeps its plan.
+*/
+void StepEngine::setMaxSpeed(uint8_t wheel, float speed) {
+  StepAxis &a = axis[wheel];
+  float limit = speed > 1.0 ? speed : 1.0;
+  float ticks = TICKS_PER_SECOND / limit;
+  uint32_t top = toSpeed(limit);
+  long steps = 0;
+  long target;
+  float entry, exit;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    a.cmin = ticks > MAX_INTERVAL ? MAX_INTERVAL : (uint32_t)ticks;
+    if (a.cruise > top) {
+      a.cruise = top;  //already planned faster than the new limit, ease down to it
+    } else if (a.cruise < top && a.mode == MODE_POSITION) {
+      target = a.target;
+      steps = (target - a.position) * a.dir;   //negative when the target is behind
+      entry = a.v / SPEED_ONE;
+      exit = a.exitSpeed / SPEED_ONE;
+      if (steps <= a.brakeSteps) {
+        steps = 0;
+      }
+    }
+  }
+  if (steps <= 0) {
+    return;
+  }
+  uint32_t cruise;
+  long brake;
+  planRamp(a, steps, entry, limit, exit, cruise, brake);   //outside the atomic block, it takes a while
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (a.mode == MODE_POSITION && a.target == target && cruise > a.cruise) {
+      a.cruise = cruise;   //still the same move, steps made meanwhile at worst reach the braking steps below cruise
+      a.brakeSteps = brake;
+    }
+  }
+}
+
+//function to set the acceleration in steps/s^2, up to STEP_MAX_ACCELERATION
+void StepEngine::setAcceleration(uint8_t wheel, float acceleration) {
+  if (acceleration <= 0) {
+    return;
+  }
+  StepAxis &a = axis[wheel];
+  a.acceleration = acceleration < STEP_MAX_ACCELERATION ? acceleration : STEP_MAX_ACCELERATION;
+  rampStart(a);
+}
+
+//function to set the jerk in steps/s^3 (up to STEP_MAX_JERK), 0 goes back to constant acceleration ramps
+//needs the acceleration set first, and is ignored while the wheel is moving
+void StepEngine::setJerk(uint8_t wheel, float jerk) {
+  StepAxis &a = axis[wheel];
+  if (jerk < 0 || a.acceleration <= 0 || a.mode != MODE_IDLE) {
+    return;
+  }
+  a.jerk = jerk < STEP_MAX_JERK ? jerk : STEP_MAX_JERK;
+  rampStart(a);
+}
+
+//function to return the steps a wheel takes to stop from a speed in steps/s with its ramp settings
+float StepEngine::stoppingSteps(uint8_t wheel, float speed) {
+  return rampSteps(axis[wheel], speed, 0);
+}
+
+//function to return the highest speed a wheel can still stop from within steps, the inverse of stoppingSteps()
+float StepEngine::stoppingSpeed(uint8_t wheel, float steps) {
+  const StepAxis &a = axis[wheel];
+  if (a.jerk <= 0) {
+    return sqrt(2.0 * a.acceleration * steps);
+  }
+  float corner = a.acceleration * a.acceleration / a.jerk;   //slowest speed whose ramp reaches the acceleration limit
+  if (steps <= rampSteps(a, corner, 0)) {
+    return cbrt(steps * steps * a.jerk);                       //steps = v sqrt(v / j)
+  }
+  return (sqrt(corner * corner + 8.0 * a.acceleration * steps) - corner) / 2.0;   //steps = v^2 / 2a + v a / 2j
+}
+
+//function to decelerate a wheel to a stop as quickly as the acceleration allows (AccelStepper::stop())
+void StepEngine::stop(uint8_t wheel) {
+  StepAxis &a = axis[wheel];
+  StepAxis &ramp = a.mode == MODE_LINKED ? path : a;
+  long stepsToStop = ramp.mode == MODE_POSITION ? stopSteps(ramp) : 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    a.hasNext = false;
+    if (a.mode == MODE_LINKED) {
+      path.hasNext = false;   //the path stops and takes both wheels with it
+      path.target = path.position + stepsToStop;
+      path.exitSpeed = 0;
+      path.brakeSteps = stepsToStop;
+    } else if (a.mode == MODE_SPEED) {
+      a.speedInterval = 0;  //constant speed has no ramp, stop now instead of after the step that is waiting
+      retime(wheel);
+    } else if (a.mode == MODE_POSITION) {
+      a.target = a.position + stepsToStop * a.dir;
+      a.exitSpeed = 0;
+      a.brakeSteps = stepsToStop;
+    }
+  }
+}
+
+//function to stop both wheels immediately without decelerating
+void StepEngine::halt() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    TIMSK1 &= ~(_BV(OCIE1A) | _BV(OCIE1B));
+    linked = false;
+    path.mode = MODE_IDLE;
+    path.hasNext = false;
+    for (uint8_t wheel = 0; wheel < 2; wheel++) {
+      axis[wheel].mode = MODE_IDLE;
+      axis[wheel].target = axis[wheel].position;
+      axis[wheel].v = 0;
+      axis[wheel].pending = 0;
+      axis[wheel].speedInterval = 0;
+      axis[wheel].hasNext = false;
+    }
+  }
+}
+
+long StepEngine::currentPosition(uint8_t wheel) {
+  long position;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    position = axis[wheel].position;
+  }
+  return position;
+}
+
+//function to redefine the current position, stops the wheel like AccelStepper::setCurrentPosition()
+void StepEngine::setCurrentPosition(uint8_t wheel, long position) {
+  StepAxis &a = axis[wheel];
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    TIMSK1 &= ~_BV(wheel == RIGHT ? OCIE1A : OCIE1B);
+    a.mode = MODE_IDLE;
+    a.position = position;
+    a.target = position;
+    a.v = 0;
+    a.pending = 0;
+    a.speedInterval = 0;
+    a.hasNext = false;
+  }
+}
+
+long StepEngine::targetPosition(uint8_t wheel) {
+  long target;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    target = axis[wheel].target;
+  }
+  return target;
+}
+
+long StepEngine::distanceToGo(uint8_t wheel) {
+  long distance;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    distance = axis[wheel].target - axis[wheel].position;
+  }
+  return distance;
+}
+
+//function to return the current signed speed in steps/s
+float StepEngine::speed(uint8_t wheel) {
+  uint32_t cn;
+  int8_t dir;
+  uint8_t mode;
+  float share = 1.0;   //fraction of the path steps this wheel makes in a linked move
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    cn = axis[wheel].cn;
+    dir = axis[wheel].dir;
+    mode = axis[wheel].mode;
+    if (mode == MODE_LINKED) {
+      cn = path.cn;
+      share = (float)link.steps[wheel] / link.major;
+    }
+  }
+  if (mode == MODE_IDLE || cn == 0) {
+    return 0;
+  }
+  return dir * share * (TICKS_PER_SECOND / cn);
+}
+
+//function to return the direction of the last step, 1 forward, -1 backward
+int8_t StepEngine::direction(uint8_t wheel) {
+  return axis[wheel].dir;
+}
+
+bool StepEngine::isRunning(uint8_t wheel) {
+  return axis[wheel].mode != MODE_IDLE;
+}
+
+bool StepEngine::isRunning() {
+  return isRunning(RIGHT) || isRunning(LEFT);
+}
@@ -0,0 +1,172 @@
+/*
+  Telemetry.cpp
+  Kyzer Bowen, Tyce Miller
+
+  Packing, CRC and COBS framing of the telemetry channels, see Telemetry.h.
+  COBS replaces every 0 in the packet with the distance to the next 0, the first byte holds the distance to the
+  first one. Packets are shorter than 254 bytes so the overhead is always one byte plus the 0 that ends the frame.
+*/
+
+#include "Telemetry.h"
+#include "RobotConfig.h"
+#include "Encoders.h"
+#include "Imu.h"
+#include "StepEngine.h"
+#include "Odometry.h"
+#include "Probes.h"
+#include <util/crc16.h>
+
+#define HEADER_SIZE 6                                            //channel, sequence, millis()
+#define PACKET_SIZE (HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + 2)    //largest packet with its CRC
+#define FRAME_SIZE (PACKET_SIZE + 2)                             //plus the COBS code byte and the 0 delimiter
+
+Telemetry telemetry;
+
+//function to start the stream on a serial port with every channel off
+void Telemetry::begin(Stream &serial) {
+  port = &serial;
+  for (uint8_t channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+    period[channel] = 0;
+    sequence[channel] = 0;
+  }
+  skipped = 0;
+  textLength = 0;
+}
+
+//function to set how many packets per second a channel sends, 0 turns it off, faster than TELEMETRY_MAX_HZ is cut to it
+void Telemetry::setRate(uint8_t channel, unsigned int hz) {
+  if (channel >= TELEMETRY_TEXT) {
+    return;   //the text channel sends when there is text
+  }
+  if (hz > TELEMETRY_MAX_HZ) {
+    hz = TELEMETRY_MAX_HZ;
+  }
+  period[channel] = hz ? 1000 / hz : 0;
+  lastSent[channel] = millis();
+}
+
+//function to send every channel that is due
+void Telemetry::update() {
+  PROBE(PROBE_TELEMETRY);
+  if (!port) {
+    return;
+  }
+  unsigned long now = millis();
+  for (uint8_t channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+    if (period[channel] == 0 || now - lastSent[channel] < period[channel]) {
+      continue;
+    }
+    lastSent[channel] += period[channel];
+    if (now - lastSent[channel] >= period[channel]) {
+      lastSent[channel] = now;   //fell behind, skip the missed frames instead of sending them back to back
+    }
+
+    switch (channel) {
+      case TELEMETRY_ENCODERS: {
+        int32_t values[4];
+        EncoderSnapshot snap;
+        encoders.snapshot(snap);
+        values[0] = snap.ticks[LEFT];
+        values[1] = snap.ticks[RIGHT];
+        values[2] = encoders.lastSpeed[LEFT];
+        values[3] = encoders.lastSpeed[RIGHT];
+        send(channel, values, sizeof(values));
+        break;
+      }
+      case TELEMETRY_IMU: {
+        struct {
+          ImuSample sample;
+          uint16_t lost;
+        } values;
+        if (!imu.latest(values.sample)) {
+          break;   //nothing from the IMU yet
+        }
+        values.lost = imu.overflows();
+        send(channel, &values, sizeof(values));
+        break;
+      }
+      case TELEMETRY_STEPPERS: {
+        int32_t values[4];
+        values[0] = stepEngine.currentPosition(LEFT);
+        values[1] = stepEngine.currentPosition(RIGHT);
+        values[2] = stepEngine.distanceToGo(LEFT);
+        values[3] = stepEngine.distanceToGo(RIGHT);
+        send(channel, values, sizeof(values));
+        break;
+      }
+      case TELEMETRY_POSE: {
+        Pose pose = odometry.pose();
+        send(channel, &pose, sizeof(pose));
+        break;
+      }
+    }
+  }
+}
+
+//function to return how many frames were dropped because the transmit buffer was full
+unsigned int Telemetry::dropped() {
+  return skipped;
+}
+
+//function to pick where text meant for a port goes, the text channel while any channel streams frames on that port
+Print &Telemetry::output(Print &text) {
+  if (port == &text) {
+    for (uint8_t channel = 0; channel < TELEMETRY_TEXT; channel++) {
+      if (period[channel]) {
+        return *this;
+      }
+    }
+  }
+  return text;
+}
+
+//function to collect text for the text channel, a line or a full payload goes out as one packet
+size_t Telemetry::write(uint8_t byte) {
+  if (!port) {
+    return 0;
+  }
+  text[textLength++] = byte;
+  if (byte == '\n' || textLength == TELEMETRY_MAX_PAYLOAD) {
+    send(TELEMETRY_TEXT, text, textLength);
+    textLength = 0;
+  }
+  return 1;
+}
+
+//function to build one packet, frame it and write it if the whole frame fits in the transmit buffer (text always waits)
+void Telemetry::send(uint8_t channel, const void *payload, uint8_t length) {
+  uint8_t packet[PACKET_SIZE];
+  uint32_t now = millis();
+  packet[0] = channel;
+  packet[1] = sequence[channel]++;
+  memcpy(&packet[2], &now, 4);
+  memcpy(&packet[HEADER_SIZE], payload, length);
+  uint8_t size = HEADER_SIZE + length;
+  uint16_t crc = 0;
+  for (uint8_t i = 0; i < size; i++) {
+    crc = _crc_xmodem_update(crc, packet[i]);
+  }
+  packet[size++] = crc & 0xFF;
+  packet[size++] = crc >> 8;
+
+  //COBS, code holds the index of the byte that gets the distance to the next 0
+  uint8_t frame[FRAME_SIZE];
+  uint8_t code = 0;
+  uint8_t out = 1;
+  for (uint8_t i = 0; i < size; i++) {
+    if (packet[i] == 0) {
+      frame[code] = out - code;
+      code = out++;
+    } else {
+      frame[out++] = packet[i];
+    }
+  }
+  frame[code] = out - code;
+  frame[out++] = 0;
+
+  if (channel != TELEMETRY_TEXT && port->availableForWrite() < out) {
+    skipped++;   //the host falls behind a frame instead of the loop waiting on the serial port
+    return;
+  }
+  port->write(frame, out);
+}
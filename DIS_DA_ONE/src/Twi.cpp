@@ -0,0 +1,155 @@
+/*
+  Twi.cpp
+  Kyzer Bowen, Tyce Miller
+
+  TWI master state machine, see Twi.h. Every TWI interrupt reads the bus status and sets up the next bus action.
+  A register read is: START, address+W, register, repeated START, address+R, data bytes (ACK all but the last), STOP.
+  A register write is: START, address+W, register, data bytes, STOP.
+*/
+
+#include "Twi.h"
+#include <util/twi.h>
+
+static TwiTransfer *volatile current = 0;   //transfer on the bus, 0 when idle
+static volatile uint8_t byteIndex;          //next data byte
+static volatile unsigned int errors = 0;    //transfers that ended with a NACK or bus error
+
+//function to hand the bus its next action with the TWI interrupt on
+static inline void twiCommand(uint8_t bits) {
+  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | bits;
+}
+
+//function to send STOP, free the bus and tell the owner of the transfer how it went
+static void finish(bool ok) {
+  TwiTransfer *transfer = current;
+  TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+  while (TWCR & _BV(TWSTO)) {
+    //a few us at 400 kHz, the next START cannot go out until the STOP is done
+  }
+  current = 0;
+  if (!ok) {
+    errors++;
+  }
+  if (transfer->done) {
+    transfer->done(ok);
+  }
+}
+
+ISR(TWI_vect) {
+  TwiTransfer *transfer = current;
+  switch (TW_STATUS) {
+    case TW_START:
+      TWDR = (transfer->address << 1) | TW_WRITE;
+      twiCommand(0);
+      break;
+    case TW_MT_SLA_ACK:
+      TWDR = transfer->reg;
+      twiCommand(0);
+      break;
+    case TW_MT_DATA_ACK:
+      if (transfer->read) {
+        twiCommand(_BV(TWSTA));  //register sent, repeated start to read
+      } else if (byteIndex < transfer->length) {
+        TWDR = transfer->data[byteIndex++];
+        twiCommand(0);
+      } else {
+        finish(true);
+      }
+      break;
+    case TW_REP_START:
+      TWDR = (transfer->address << 1) | TW_READ;
+      twiCommand(0);
+      break;
+    case TW_MR_SLA_ACK:
+      twiCommand(transfer->length > 1 ? _BV(TWEA) : 0);  //NACK the only byte of a one byte read
+      break;
+    case TW_MR_DATA_ACK:
+      transfer->data[byteIndex++] = TWDR;
+      twiCommand(byteIndex + 1 < transfer->length ? _BV(TWEA) : 0);
+      break;
+    case TW_MR_DATA_NACK:
+      transfer->data[byteIndex++] = TWDR;
+      finish(true);
+      break;
+    default:
+      finish(false);  //NACK, lost arbitration or bus error
+      break;
+  }
+}
+
+//function to set the bus clock and turn on the TWI, SDA and SCL get the internal pull ups like Wire does
+void twiBegin(unsigned long hz) {
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+  TWSR = 0;                           //prescaler 1
+  TWBR = ((F_CPU / hz) - 16) / 2;     //SCL = F_CPU / (16 + 2 * TWBR)
+  TWCR = _BV(TWEN);
+}
+
+//function to start a transfer in the background, false if another transfer still has the bus
+bool twiStart(TwiTransfer *transfer) {
+  uint8_t sreg = SREG;
+  cli();
+  if (current) {
+    SREG = sreg;
+    return false;
+  }
+  current = transfer;
+  byteIndex = 0;
+  twiCommand(_BV(TWSTA));
+  SREG = sreg;
+  return true;
+}
+
+bool twiBusy() {
+  return current != 0;
+}
+
+//function to return how many transfers have failed
+unsigned int twiErrors() {
+  unsigned int count;
+  uint8_t sreg = SREG;
+  cli();
+  count = errors;
+  SREG = sreg;
+  return count;
+}
+
+static volatile uint8_t blockingResult;   //0 while running, 1 ok, 2 failed
+
+static void blockingDone(bool ok) {
+  blockingResult = ok ? 1 : 2;
+}
+
+//function to run a transfer and wait for it, resets the TWI if the bus hangs
+static bool runBlocking(TwiTransfer *transfer) {
+  unsigned long start = millis();
+  blockingResult = 0;
+  while (!twiStart(transfer)) {
+    if (millis() - start > TWI_TIMEOUT_MS) {
+      return false;
+    }
+  }
+  while (blockingResult == 0) {
+    if (millis() - start > TWI_TIMEOUT_MS) {
+      TWCR = 0;           //release the bus
+      TWCR = _BV(TWEN);
+      current = 0;
+      errors++;
+      return false;
+    }
+  }
+  return blockingResult == 1;
+}
+
+//function to write one register and wait for it, for setup code
+bool twiWriteRegister(uint8_t address, uint8_t reg, uint8_t value) {
+  TwiTransfer transfer = {address, reg, &value, 1, false, blockingDone};
+  return runBlocking(&transfer);
+}
+
+//function to read registers and wait for them, for setup code
+bool twiReadRegisters(uint8_t address, uint8_t reg, uint8_t *data, uint8_t length) {
+  TwiTransfer transfer = {address, reg, data, length, true, blockingDone};
+  return runBlocking(&transfer);
+}
@@ -0,0 +1,135 @@
+/*
+  WheelControl.cpp
+  Kyzer Bowen, Tyce Miller
+
+  PID speed trim and slip correction for the motion queue, see WheelControl.h.
+  The encoders only see 1 tick every 20 steps, so errors under 1 tick are quantization and are ignored (deadband).
+  Anti-windup: the integral stops growing while the trim is saturated in the direction of the error, and is
+  clamped to CONTROL_I_LIMIT either way.
+*/
+
+#include "WheelControl.h"
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include "Encoders.h"
+
+#define CONTROL_HZ (1000000UL / CONTROL_PERIOD_US)
+#define CONTROL_DT toFix(CONTROL_PERIOD_US / 1000000.0)   //control period in s, Q16.16
+#define CONTROL_I_LIMIT toFix(5.0)                          //largest integral in tick*s
+#define STEPS_PER_TICK (stepsPerRev / ticksPerRev)
+
+WheelController wheelControl;
+
+//function to load the default gains
+void WheelController::begin() {
+  setGains(toFix(40.0), toFix(20.0), toFix(0.5));
+  active = false;
+}
+
+//function to set the PID gains, the trim is in steps/s per tick of error
+void WheelController::setGains(fix16 kp, fix16 ki, fix16 kd) {
+  this->kp = kp;
+  this->ki = ki;
+  this->kd = kd;
+}
+
+//function to start tracking a segment, call it while the wheels are still stopped at the start of the segment
+void WheelController::start(const MotionSegment &segment) {
+  goalTicks = segment.ticks < 0 ? -segment.ticks : segment.ticks;   //the encoders only count up
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    steps[wheel] = segment.steps[wheel];
+    speed[wheel] = segment.speed[wheel];
+    startPos[wheel] = stepEngine.currentPosition(wheel);
+    startTicks[wheel] = encoders.total(wheel);
+    ticksPerStep[wheel] = steps[wheel] != 0 ? goalTicks / labs(steps[wheel]) : 0;
+    err[wheel] = 0;
+    integral[wheel] = 0;
+    extra[wheel] = 0;
+    done[wheel] = steps[wheel] == 0;
+  }
+  active = true;
+}
+
+//function to run one control period for both wheels while a segment is tracked
+void WheelController::update() {
+  if (!active) {
+    return;
+  }
+  for (uint8_t wheel = 0; wheel < 2; wheel++) {
+    if (steps[wheel] != 0) {
+      control(wheel);
+    }
+  }
+}
+
+/*
+  One control period for one wheel.
+  reference = ticks the wheel should have counted for the steps made so far (all of goalTicks once the planned steps are done)
+  error = reference - counted ticks, less the 1 tick deadband
+  speed trim = kp * error + ki * integral + kd * d(error)/dt, only while the planned steps are still running
+  extra steps = steps already past the plan + missing ticks * 20 steps per tick, added to the step target
+*/
+void WheelController::control(uint8_t wheel) {
+  long planned = labs(steps[wheel]);
+  long made = labs(stepEngine.currentPosition(wheel) - startPos[wheel]);
+  fix16 reference = made >= planned ? goalTicks : made * ticksPerStep[wheel];
+  long counted = encoders.total(wheel) - startTicks[wheel];
+  fix16 e = reference - fixFromInt(counted);
+  if (e > FIX_ONE) {
+    e -= FIX_ONE;
+  } else if (e < -FIX_ONE) {
+    e += FIX_ONE;
+  } else {
+    e = 0;  //inside one tick of the reference
+  }
+  fix16 change = e - err[wheel];
+  err[wheel] = e;
+
+  //PID speed trim while the wheel is on its planned steps
+  if (made < planned) {
+    fix16 lastIntegral = integral[wheel];
+    integral[wheel] += fixMul(e, CONTROL_DT);
+    integral[wheel] = constrain(integral[wheel], -CONTROL_I_LIMIT, CONTROL_I_LIMIT);
+    fix16 trim = fixMul(kp, e) + fixMul(ki, integral[wheel]) + fixMul(kd, change * CONTROL_HZ);
+    float maxTrim = speed[wheel] * CONTROL_MAX_TRIM / 100;
+    float trimmed = trim / 65536.0;
+    if (trimmed > maxTrim || trimmed < -maxTrim) {
+      trimmed = trimmed > 0 ? maxTrim : -maxTrim;
+      if ((e > 0) == (trim > 0)) {
+        integral[wheel] = lastIntegral;  //saturated, do not wind up
+      }
+    }
+    stepEngine.setMaxSpeed(wheel, speed[wheel] + trimmed);
+  }
+
+  /*slip correction on the step target, it only ever grows. The encoders count both directions, so pulling the
+    target back over a surplus tick would count more ticks and run away.*/
+  long maxExtra = planned * CONTROL_MAX_EXTRA / 100 + 2 * STEPS_PER_TICK;
+  long wanted = (made > planned ? made - planned : 0) + (e > 0 ? fixRound(e * STEPS_PER_TICK) : 0);
+  bool limited = wanted >= maxExtra;
+  if (limited) {
+    wanted = maxExtra;
+  }
+  if (wanted > extra[wheel]) {
+    extra[wheel] = wanted;
+    long distance = planned + wanted;
+    stepEngine.moveTo(wheel, startPos[wheel] + (steps[wheel] < 0 ? -distance : distance));
+  }
+
+  done[wheel] = !stepEngine.isRunning(wheel) && (e <= 0 || limited);
+}
+
+//function to stop trimming, the wheels finish whatever target they have
+void WheelController::stop() {
+  active = false;
+}
+
+//function to tell if both wheels have stopped on their encoder goal
+bool WheelController::settled() {
+  return !active || (done[RIGHT] && done[LEFT]);
+}
+
+//function to return the last tick error of a wheel in Q16.16 (deadband removed)
+fix16 WheelController::error(uint8_t wheel) {
+  return err[wheel];
+}
@@ -13,7 +13,10 @@
 
   This program will introduce using the stepper motor library to create motion algorithms for the robot.
   The motions will be go to angle, go to goal, move in a circle, square, figure eight and teleoperation (stop, forward, spin, reverse, turn)
+  Each motion function adds its moves to the motion queue (MotionQueue.h) and returns right away, loop() keeps the queue running.
+  loop() only runs the task scheduler (Scheduler.h), the task table above setup() sets what runs and how often.
   It will also include wireless commmunication for remote control of the robot by using a game controller or serial monitor.
+  Commands such as "forward 30;" or "goto 50 -20;" from either one run the motion functions (CommandParser.h).
   The primary functions created are
   moveCircle - given the diameter in inches and direction of clockwise or counterclockwise, move the robot in a circle with that diameter
   moveFigure8 - given the diameter in inches, use the moveCircle() function with direction input to create a Figure 8
@@ -24,6 +27,8 @@
   stop -both wheels stationary
 
   Interrupts
+  Wheel steps are generated by the Timer1 compare interrupts in StepEngine.cpp, runToStop() only waits for them to finish
+  Encoder ticks are counted and time stamped by the interrupts in Encoders.cpp, update_encoder_data() turns them into wheel speeds
   https://www.arduino.cc/reference/en/language/functions/external-interrupts/attachinterrupt/
   https://www.arduino.cc/en/Tutorial/CurieTimer1Interrupt
   https://playground.arduino.cc/code/timer1
@@ -48,6 +53,9 @@
   digital pin 18 - left encoder pin
   digital pin 19 - right encoder pin
 
+  digital pin 16 (TX2) - Bluetooth RX
+  digital pin 17 (RX2) - Bluetooth TX
+
   digital pin 2 - IMU INT
   digital pin 20 - IMU SDA
   digital pin 21 - IMU SCL
@@ -63,10 +71,27 @@
 */
 
 #include <Arduino.h>
-#include <Accelstepper.h>
+#include <AccelStepper.h>
 #include <MultiStepper.h>
-#include <Adafruit_MPU6050.h>
-#include <SoftwareSerial.h>
+#include "RobotConfig.h"
+#include "StepEngine.h"
+#include "StepDriver.h"
+#include "MotionQueue.h"
+#include "WheelControl.h"
+#include "HeadingHold.h"
+#include "PathFollower.h"
+#include "Encoders.h"
+#include "Odometry.h"
+#include "Imu.h"
+#include "Telemetry.h"
+#include "Bluetooth.h"
+#include "CommandParser.h"
+#include "FixedKinematics.h"
+#include "Calibration.h"
+#include "Boot.h"
+#include "Scheduler.h"
+#include "Profiler.h"
+#include "Probes.h"
 
 //state LEDs connections
 #define redLED 5            //red LED for displaying states
@@ -74,143 +99,121 @@
 #define ylwLED 7            //yellow LED for displaying states
 #define enableLED 13        //stepper enabled LED
 
-//define motor pin numbers
-#define stepperEnable 48    //stepper enable pin on stepStick 
-#define rtStepPin 50 //right stepper motor step pin 
-#define rtDirPin 51  // right stepper motor direction pin 
-#define ltStepPin 52 //left stepper motor step pin 
-#define ltDirPin 53  //left stepper motor direction pin 
-
-AccelStepper stepperRight(AccelStepper::DRIVER, rtStepPin, rtDirPin);//create instance of right stepper motor object (2 driver pins, low to high transition step pin 52, direction input pin 53 (high means forward)
-AccelStepper stepperLeft(AccelStepper::DRIVER, ltStepPin, ltDirPin);//create instance of left stepper motor object (2 driver pins, step pin 50, direction input pin 51)
+AccelStepper stepperRight(rightStepForward, rightStepBackward);//create instance of right stepper motor object, steps go through the PORTB driver in StepDriver.h (step pin 50, direction pin 51, high means forward)
+AccelStepper stepperLeft(leftStepForward, leftStepBackward);//create instance of left stepper motor object, steps go through the PORTB driver in StepDriver.h (step pin 52, direction pin 53)
 MultiStepper steppers;//create instance to control multiple steppers at the same time
 
-#define stepperEnTrue false //variable for enabling stepper motor
-#define stepperEnFalse true //variable for disabling stepper motor
-
-int pauseTime = 2500;   //time before robot moves
 int stepTime = 500;     //delay time between high and low on step pin
-int wait_time = 2000;   //delay for printing data
-
-//define encoder pins
-#define LEFT 1        //left encoder
-#define RIGHT 0       //right encoder
-const int ltEncoder = 18;        //left encoder pin (Mega Interrupt pins 2,3 18,19,20,21)
-const int rtEncoder = 19;        //right encoder pin (Mega Interrupt pins 2,3 18,19,20,21)
-volatile long encoder[2] = {0, 0};  //interrupt variable to hold number of encoder counts (left, right)
-int lastSpeed[2] = {0, 0};          //variable to hold encoder speed (left, right)
-int accumTicks[2] = {0, 0};         //variable to hold accumulated ticks since last reset
-
-//define robot measurements
-const float wheelDiam = 8.6;    // Wheel diameter on robot (cm)
-const float wheelCirc = wheelDiam*PI;    // Wheel circumfrence on robot (cm)
-const float robotDiam = 21;   // Robot Diameter from center to center of the wheels (cm)
+const unsigned long wait_time = 2000;   //ms between runs of report_task(), the demo moves and data prints
+
+//encoder pins and LEFT/RIGHT wheel indices are in RobotConfig.h, the encoder counts and speeds are in Encoders.h
+EncoderSnapshot printMark;          //encoder counts at the last print, print_encoder_data() shows the ticks since then
+
+//robot measurements (wheelDiam, wheelCirc, robotDiam) are in RobotConfig.h, FixedKinematics.h turns them into step conversions
+//and Calibration.h replaces them with the measured ones kept in EEPROM
 
 // define motor velocity 
 volatile float veloLeft;
 volatile float veloRight;
 
-// define motor error
-volatile int errorLeft;
-volatile int errorRight;
+//the IMU is the imu object in Imu.h (MPU6050 on interrupt driven I2C, INT on pin 2)
+bool imuReady = false;   //the IMU is found and its gyro zero is taken
+long gyroYaw = 0;        //gyro z counts read_gyro_rate() has added up, calspin measures its angle with it
+#define IMU_STEP_RESET 0    //boot IMU stage: waiting IMU_RESET_MS for the MPU6050 reset
+#define IMU_STEP_ZERO 1     //boot IMU stage: taking the gyro zero
+uint8_t imuStep;            //where the boot IMU stage is
+unsigned long imuStamp;     //millis() the IMU step started
 
-//IMU object
-Adafruit_MPU6050 mpu;
+//the Bluetooth module is the bluetooth object in Bluetooth.h (HC-05 on hardware USART2, TX2 pin 16 and RX2 pin 17)
 
-//Bluetooth module connections
-#define BTTX 10 // TX on chip to pin 10 on Arduino Mega
-#define BTRX 11 //, RX on chip to pin 11 on Arduino Mega
-SoftwareSerial BTSerial(BTTX, BTRX);
+//remote control commands, one parser per port so bytes from the two never mix (command table is above setup())
+CommandParser serialCommands;
+CommandParser bluetoothCommands;
+Print *commandPort = &Serial;   //port the command being run came in on, for commands that answer with more than "ok"
 
 // Helper Functions
 
-//interrupt function to count left encoder tickes
-void LwheelSpeed()
-{
-  encoder[LEFT] ++;  //count the left wheel encoder interrupts
-}
-
-//interrupt function to count right encoder ticks
-void RwheelSpeed()
-{
-  encoder[RIGHT] ++; //count the right wheel encoder interrupts
-}
-
 //function to initialize Bluetooth
 void init_BT(){
   Serial.println("Goodnight moon!");
-  BTSerial.println("Hello, world?");
+  bluetooth.println("Hello, world?");
+}
+//function to read the yaw rate for the odometry in degrees/s, counterclockwise positive
+bool read_gyro_rate(fix16 *degreesPerSec) {
+  ImuSample sample;
+  long sum = 0;
+  uint8_t count = 0;
+  while (imu.read(sample)) {  //average every sample since the last call
+    sum += sample.gyro[2];
+    count++;
+  }
+  gyroYaw += sum;
+  if (count == 0) {
+    return false;
+  }
+  *degreesPerSec = sum * toFix(1.0 / IMU_GYRO_LSB) / count;
+  return true;
 }
-//function to initialize IMU
+
+/*
+  Starts the IMU stage of the boot (Boot.h), service_IMU() finishes it from loop(). Without an MPU6050 on the bus
+  the stage fails here after one TWI timeout and the odometry runs on the encoders alone.
+*/
 void init_IMU(){
-  Serial.println("Adafruit MPU6050 init!");
+  boot.start(BOOT_IMU);
+  if (!imu.reset()) {
+    telemetry.output(Serial).println("Failed to find MPU6050 chip, running without the gyro");
+    boot.finish(BOOT_IMU, false);
+    return;
+  }
+  imuStep = IMU_STEP_RESET;
+  imuStamp = millis();
+}
 
-  // Try to initialize!
-  if (!mpu.begin()) {
-    Serial.println("Failed to find MPU6050 chip");
-    while (1) {
-      delay(10);
+/*
+  Runs the IMU stage of the boot one step at a time, nothing here waits. After the reset it sets up the MPU6050,
+  then averages IMU_SAMPLE_HZ gyro samples (1 second) for the zero rate while the wheels are stopped. A move during
+  the average starts it over, samples that stop coming for BOOT_IMU_TIMEOUT_MS fail the stage.
+*/
+void service_IMU(){
+  if (boot.state(BOOT_IMU) != BOOT_RUNNING) {
+    return;
+  }
+  if (imuStep == IMU_STEP_RESET) {
+    if (millis() - imuStamp < IMU_RESET_MS) {
+      return;
+    }
+    if (!imu.configure()) {
+      telemetry.output(Serial).println("MPU6050 setup failed, running without the gyro");
+      boot.finish(BOOT_IMU, false);
+      return;
     }
+    Print &out = telemetry.output(Serial);//calspin can restart this stage with the telemetry streaming
+    out.println("MPU6050 Found!");
+    out.println("Accelerometer range set to: +-8G");
+    out.println("Gyro range set to: +- 500 deg/s");
+    out.println("Filter bandwidth set to: 44 Hz");
+    out.print("Sample rate set to: ");
+    out.print(IMU_SAMPLE_HZ);
+    out.println(" Hz");
+    imu.calibrateStart();
+    imuStep = IMU_STEP_ZERO;
+    imuStamp = millis();
+    return;
   }
-  Serial.println("MPU6050 Found!");
-
-  mpu.setAccelerometerRange(MPU6050_RANGE_8_G);
-  Serial.print("Accelerometer range set to: ");
-  switch (mpu.getAccelerometerRange()) {
-  case MPU6050_RANGE_2_G:
-    Serial.println("+-2G");
-    break;
-  case MPU6050_RANGE_4_G:
-    Serial.println("+-4G");
-    break;
-  case MPU6050_RANGE_8_G:
-    Serial.println("+-8G");
-    break;
-  case MPU6050_RANGE_16_G:
-    Serial.println("+-16G");
-    break;
-  }
-  mpu.setGyroRange(MPU6050_RANGE_500_DEG);
-  Serial.print("Gyro range set to: ");
-  switch (mpu.getGyroRange()) {
-  case MPU6050_RANGE_250_DEG:
-    Serial.println("+- 250 deg/s");
-    break;
-  case MPU6050_RANGE_500_DEG:
-    Serial.println("+- 500 deg/s");
-    break;
-  case MPU6050_RANGE_1000_DEG:
-    Serial.println("+- 1000 deg/s");
-    break;
-  case MPU6050_RANGE_2000_DEG:
-    Serial.println("+- 2000 deg/s");
-    break;
-  }
-
-  mpu.setFilterBandwidth(MPU6050_BAND_21_HZ);
-  Serial.print("Filter bandwidth set to: ");
-  switch (mpu.getFilterBandwidth()) {
-  case MPU6050_BAND_260_HZ:
-    Serial.println("260 Hz");
-    break;
-  case MPU6050_BAND_184_HZ:
-    Serial.println("184 Hz");
-    break;
-  case MPU6050_BAND_94_HZ:
-    Serial.println("94 Hz");
-    break;
-  case MPU6050_BAND_44_HZ:
-    Serial.println("44 Hz");
-    break;
-  case MPU6050_BAND_21_HZ:
-    Serial.println("21 Hz");
-    break;
-  case MPU6050_BAND_10_HZ:
-    Serial.println("10 Hz");
-    break;
-  case MPU6050_BAND_5_HZ:
-    Serial.println("5 Hz");
-    break;
+
+  if (motionQueue.busy() || stepEngine.isRunning()) { //the average would hold the turn rate, start over once stopped
+    ImuSample sample;
+    while (imu.read(sample)) {}
+    imu.calibrateStart();
+    imuStamp = millis();
+  } else if (imu.calibratePoll(IMU_SAMPLE_HZ)) {
+    imuReady = true;
+    odometry.setGyro(read_gyro_rate); //the pose estimate can use the gyro from now on
+    boot.finish(BOOT_IMU, true);
+  } else if (millis() - imuStamp > BOOT_IMU_TIMEOUT_MS) {
+    telemetry.output(Serial).println("MPU6050 samples stopped, check the INT wire on pin 2");
+    boot.finish(BOOT_IMU, false);
   }
 }
 
@@ -227,13 +230,11 @@ void init_stepper(){
   pinMode(redLED, OUTPUT);//set red LED as output
   pinMode(grnLED, OUTPUT);//set green LED as output
   pinMode(ylwLED, OUTPUT);//set yellow LED as output
-  digitalWrite(redLED, HIGH);//turn on red LED
-  digitalWrite(ylwLED, HIGH);//turn on yellow LED
-  digitalWrite(grnLED, HIGH);//turn on green LED
-  delay(pauseTime / 5); //wait 0.5 seconds
-  digitalWrite(redLED, LOW);//turn off red LED
-  digitalWrite(ylwLED, LOW);//turn off yellow LED
-  digitalWrite(grnLED, LOW);//turn off green LED
+  if (BOOT_LED_MS) { //LED check (FAST_BOOT=0 only), boot_service() turns them off after BOOT_LED_MS
+    digitalWrite(redLED, HIGH);//turn on red LED
+    digitalWrite(ylwLED, HIGH);//turn on yellow LED
+    digitalWrite(grnLED, HIGH);//turn on green LED
+  }
 
   stepperRight.setMaxSpeed(1500);//set the maximum permitted speed limited by processor and clock speed, no greater than 4000 steps/sec on Arduino
   stepperRight.setAcceleration(10000);//set desired acceleration in steps/s^2
@@ -241,138 +242,186 @@ void init_stepper(){
   stepperLeft.setAcceleration(10000);//set desired acceleration in steps/s^2
   steppers.addStepper(stepperRight);//add right motor to MultiStepper
   steppers.addStepper(stepperLeft);//add left motor to MultiStepper
+
+  stepEngine.begin();//start the interrupt driven step engine on Timer1
+  stepEngine.setMaxSpeed(RIGHT, 1500);//set the maximum permitted speed, the compare ISRs can go well past the 4000 steps/sec run() limit
+  stepEngine.setAcceleration(RIGHT, 10000);//set desired acceleration in steps/s^2
+  stepEngine.setMaxSpeed(LEFT, 1500);//set the maximum permitted speed
+  stepEngine.setAcceleration(LEFT, 10000);//set desired acceleration in steps/s^2
   digitalWrite(stepperEnable, stepperEnTrue);//turns on the stepper motor driver
   digitalWrite(enableLED, HIGH);//turn on enable LED
 }
 
-//function prints encoder data to serial monitor
+//function prints encoder data to serial monitor, report_task() runs it every wait_time when it is uncommented
 void print_encoder_data() {
-  static unsigned long timer = 0;                           //print manager timer
-  if (millis() - timer > 100) {                             //print encoder data every 100 ms or so
-    lastSpeed[LEFT] = encoder[LEFT];                        //record the latest left speed value
-    lastSpeed[RIGHT] = encoder[RIGHT];                      //record the latest right speed value
-    accumTicks[LEFT] = accumTicks[LEFT] + encoder[LEFT];    //record accumulated left ticks
-    accumTicks[RIGHT] = accumTicks[RIGHT] + encoder[RIGHT]; //record accumulated right ticks
-    Serial.println("Encoder value:");
-    Serial.print("\tLeft:\t");
-    Serial.print(encoder[LEFT]);
-    Serial.print("\tRight:\t");
-    Serial.println(encoder[RIGHT]);
-    Serial.println("Accumulated Ticks: ");
-    Serial.print("\tLeft:\t");
-    Serial.print(accumTicks[LEFT]);
-    Serial.print("\tRight:\t");
-    Serial.println(accumTicks[RIGHT]);
-    encoder[LEFT] = 0;                          //clear the left encoder data buffer
-    encoder[RIGHT] = 0;                         //clear the right encoder data buffer
-    timer = millis();                           //record current time since program started
-  }
-}
-
-// function resets encoder data
+  long ticks[2];
+  encoders.delta(printMark, ticks);                       //ticks since the last print, printMark moves up to now
+  Serial.println("Encoder value:");
+  Serial.print("\tLeft:\t");
+  Serial.print(ticks[LEFT]);
+  Serial.print("\tRight:\t");
+  Serial.println(ticks[RIGHT]);
+  Serial.println("Accumulated Ticks: ");
+  Serial.print("\tLeft:\t");
+  Serial.print(printMark.ticks[LEFT]);
+  Serial.print("\tRight:\t");
+  Serial.println(printMark.ticks[RIGHT]);
+  Serial.println("Wheel Speed (cm/s): ");
+  Serial.print("\tLeft:\t");
+  Serial.print(encoders.lastSpeed[LEFT] / 65536.0);
+  Serial.print("\tRight:\t");
+  Serial.println(encoders.lastSpeed[RIGHT] / 65536.0);
+}
+
+// function restarts the tick counts shown by print_encoder_data(), the encoder counters themselves are never cleared
 void reset_encoder_data() {
-  encoder[LEFT] = 0;                          //clear the left encoder data buffer
-  encoder[RIGHT] = 0;                         //clear the right encoder data buffer
+  encoders.snapshot(printMark);
 }
 
+//function to refresh the wheel speeds (encoders.lastSpeed) from the encoder tick times
 void update_encoder_data(){
-
-    lastSpeed[LEFT] = encoder[LEFT];                        //record the latest left speed value
-    lastSpeed[RIGHT] = encoder[RIGHT];                      //record the latest right speed value
-    accumTicks[LEFT] = accumTicks[LEFT] + encoder[LEFT];    //record accumulated left ticks
-    accumTicks[RIGHT] = accumTicks[RIGHT] + encoder[RIGHT]; //record accumulated right ticks
+  encoders.update();
 }
 
 //function to print IMU data to the serial monitor
 void print_IMU_data(){
-    /* Get new sensor events with the readings */
-  sensors_event_t a, g, temp;
-  mpu.getEvent(&a, &g, &temp);
+    /* Get the newest sample from the IMU buffer, nothing waits on the I2C bus */
+  ImuSample sample;
+  if (!imu.latest(sample)) {
+    return;
+  }
 
   /* Print out the values */
   Serial.print("Acceleration X: ");
-  Serial.print(a.acceleration.x);
+  Serial.print(sample.accel[0] * IMU_GRAVITY / IMU_ACCEL_LSB);
   Serial.print(", Y: ");
-  Serial.print(a.acceleration.y);
+  Serial.print(sample.accel[1] * IMU_GRAVITY / IMU_ACCEL_LSB);
   Serial.print(", Z: ");
-  Serial.print(a.acceleration.z);
+  Serial.print(sample.accel[2] * IMU_GRAVITY / IMU_ACCEL_LSB);
   Serial.println(" m/s^2");
 
   Serial.print("Rotation X: ");
-  Serial.print(g.gyro.x);
+  Serial.print(sample.gyro[0] * DEG_TO_RAD / IMU_GYRO_LSB);
   Serial.print(", Y: ");
-  Serial.print(g.gyro.y);
+  Serial.print(sample.gyro[1] * DEG_TO_RAD / IMU_GYRO_LSB);
   Serial.print(", Z: ");
-  Serial.print(g.gyro.z);
+  Serial.print(sample.gyro[2] * DEG_TO_RAD / IMU_GYRO_LSB);
   Serial.println(" rad/s");
 
   Serial.print("Temperature: ");
-  Serial.print(temp.temperature);
+  Serial.print(sample.temperature / 340.0 + 36.53);
   Serial.println(" degC");
 
   Serial.println("");
 }
 
-//function to send and receive data with the Bluetooth
+/*
+  Finishes the boot stages that take time (Boot.h), run by the boot task and returns at once when there is nothing
+  left to do. The serial port is given BOOT_SERIAL_TIMEOUT_MS, Bluetooth works without it.
+*/
+void boot_service() {
+  static bool started = false;   //"Robot starting..." printed
+  if (started && boot.done()) {
+    return;
+  }
+  if (BOOT_LED_MS && boot.elapsed() >= BOOT_LED_MS) {
+    digitalWrite(redLED, LOW);//turn off red LED
+    digitalWrite(ylwLED, LOW);//turn off yellow LED
+    digitalWrite(grnLED, LOW);//turn off green LED
+  }
+  if (boot.state(BOOT_COMMS) == BOOT_RUNNING && (Serial || boot.elapsed() > BOOT_SERIAL_TIMEOUT_MS)) {
+    boot.finish(BOOT_COMMS, true);
+  }
+  service_IMU();
+  if (!started && boot.commandsReady()) {
+    Serial.println("Robot starting...");
+    Serial.println("");
+    started = true;
+  }
+}
+
+//function to answer a command on the port it came from
+void reply_command(Print &port, CommandResult result) {
+  if (result == COMMAND_DONE) {
+    port.println("ok");
+  } else if (result == COMMAND_UNKNOWN) {
+    port.println("unknown command");
+  } else if (result == COMMAND_BAD) {
+    port.println("bad command");
+  }
+}
+
+//function to run the ';' terminated commands waiting on the serial monitor and Bluetooth (CommandParser.h), one answer each
 void Bluetooth_comm(){
-  String data="";
-  if (Serial.available()) {
-     while (Serial.available()){
-      char nextChar = Serial.read();
-      data = data + String(nextChar); 
-      if (nextChar == ';') {
-        break;
-      }
-     }
-    Serial.println(data);
-    BTSerial.println(data);
+  CommandResult result;
+  {
+    PROBE(PROBE_SERIAL);
+    commandPort = &telemetry.output(Serial);//text on a port that streams telemetry goes in the text channel
+    while ((result = serialCommands.poll(Serial)) != COMMAND_NONE) {
+      reply_command(telemetry.output(Serial), result);
+      commandPort = &telemetry.output(Serial);//the command may have turned the stream on or off
+    }
   }
-  
-  if (BTSerial.available()) {
-    while (BTSerial.available()){
-      char nextChar = BTSerial.read();
-      data = data + String(nextChar); 
-      if (nextChar == ';') {
-        break;
-      }
+  {
+    PROBE(PROBE_BLUETOOTH);
+    commandPort = &telemetry.output(bluetooth);
+    while ((result = bluetoothCommands.poll(bluetooth)) != COMMAND_NONE) {
+      reply_command(telemetry.output(bluetooth), result);
+      commandPort = &telemetry.output(bluetooth);
     }
-    Serial.println(data);
-    BTSerial.println(data);
   }
 }
-  
-  
+
 /*function to run both wheels to a position at speed*/
 void runAtSpeedToPosition() {
   stepperRight.runSpeedToPosition();
   stepperLeft.runSpeedToPosition();
 }
 
-/*function to run both wheels continuously at a speed*/
+/*function called over and over while the robot waits for a move to finish, the wheels keep stepping from the
+  Timer1 interrupts and the scheduler runs every task that is due meanwhile (motion queue, wheel speeds, pose, telemetry)*/
+void background_tasks() {
+  scheduler.run();   //the task that is waiting is skipped, a command does not read the next command from inside itself
+}
+
+/*function to run both wheels continuously at the speeds handed to stepEngine.setSpeed()*/
 void runAtSpeed ( void ) {
-  while (stepperRight.runSpeed() || stepperLeft.runSpeed()) {
+  while (stepEngine.isRunning()) {
+    background_tasks();
   }
 }
 
-/*This function, runToStop(), will run the robot until the target is achieved and
-   then stop it
+/*This function, runToStop(), will wait until everything in the motion queue has finished and the wheels have stopped.
+   The steps themselves come from the Timer1 compare interrupts so timing does not depend on this loop
 */
 void runToStop ( void ) {
-  int runNow = 1;
+  PROBE(PROBE_RUN_TO_STOP);
+  while (motionQueue.busy() || stepEngine.isRunning()) {
+    background_tasks();
+  }
+}
+
+/*function to add a segment to the motion queue, only waits if the queue is already full*/
+unsigned int queue_motion(MotionSegment &seg) {
+  unsigned int id = motionQueue.push(seg);
+  while (id == 0) {
+    background_tasks();
+    id = motionQueue.push(seg);
+  }
+  return id;
+}
+
+/*function to run the AccelStepper objects to their targets by polling run(), only used by the library demos*/
+void runSteppersToStop ( void ) {
   int rightStopped = 0;
   int leftStopped = 0;
 
-  while (runNow) {
+  while (!(rightStopped && leftStopped)) {
     if (!stepperRight.run()) {
       rightStopped = 1;
-      stepperRight.stop();//stop right motor
     }
     if (!stepperLeft.run()) {
       leftStopped = 1;
-      stepperLeft.stop();//stop ledt motor
-    }
-    if (rightStopped && leftStopped) {
-      runNow = 0;
     }
   }
 }
@@ -382,33 +431,27 @@ void runToStop ( void ) {
    The move1() function will move the robot forward one full rotation and backwared on
    full rotation.  Recall that that there 200 steps in one full rotation or 1.8 degrees per
    step. This function uses setting the step pins high and low with delays to move. The speed is set by
-   the length of the delay.
+   the length of the delay. Both step pins are on PORTB so each edge is one register write for both wheels.
 */
 void move1() {
   digitalWrite(redLED, HIGH);//turn on red LED
   digitalWrite(grnLED, LOW);//turn off green LED
   digitalWrite(ylwLED, LOW);//turn off yellow LED
-  digitalWrite(ltDirPin, HIGH); // Enables the motor to move in a particular direction
-  digitalWrite(rtDirPin, HIGH); // Enables the motor to move in a particular direction
+  setDirBits(DIR_BITS, DIR_BITS); // Enables both motors to move in a particular direction
   // Makes 800 pulses for making one full cycle rotation
   for (int x = 0; x < 800; x++) {
-    digitalWrite(rtStepPin, HIGH);
-    digitalWrite(ltStepPin, HIGH);
+    stepHigh(STEP_BITS);//both step pins high on the same cycle
     delayMicroseconds(stepTime);
-    digitalWrite(rtStepPin, LOW);
-    digitalWrite(ltStepPin, LOW);
+    stepLow(STEP_BITS);//both step pins low on the same cycle
     delayMicroseconds(stepTime);
   }
   delay(1000); // One second delay
-  digitalWrite(ltDirPin, LOW); // Enables the motor to move in opposite direction
-  digitalWrite(rtDirPin, LOW); // Enables the motor to move in opposite direction
+  setDirBits(DIR_BITS, 0); // Enables both motors to move in opposite direction
   // Makes 800 pulses for making one full cycle rotation
   for (int x = 0; x < 800; x++) {
-    digitalWrite(rtStepPin, HIGH);
-    digitalWrite(ltStepPin, HIGH);
+    stepHigh(STEP_BITS);//both step pins high on the same cycle
     delayMicroseconds(stepTime);
-    digitalWrite(rtStepPin, LOW);
-    digitalWrite(ltStepPin, LOW);
+    stepLow(STEP_BITS);//both step pins low on the same cycle
     delayMicroseconds(stepTime);
   }
   delay(1000); // One second delay
@@ -435,7 +478,7 @@ void move2() {
   stepperLeft.setSpeed(1000);//set left motor speed
   stepperRight.runSpeedToPosition();//move right motor
   stepperLeft.runSpeedToPosition();//move left motor
-  runToStop();//run until the robot reaches the target
+  runSteppersToStop();//run until the robot reaches the target
   delay(1000); // One second delay
   stepperRight.moveTo(0);//move one full rotation backward relative to current position
   stepperLeft.moveTo(0);//move one full rotation backward relative to current position
@@ -443,7 +486,7 @@ void move2() {
   stepperLeft.setSpeed(1000);//set left motor speed
   stepperRight.runSpeedToPosition();//move right motor
   stepperLeft.runSpeedToPosition();//move left motor
-  runToStop();//run until the robot reaches the target
+  runSteppersToStop();//run until the robot reaches the target
   delay(1000); // One second delay
 }
 
@@ -511,8 +554,8 @@ void move5() {
   digitalWrite(ylwLED, HIGH);//turn on yellow LED
   int leftSpd = 5000;//right motor speed
   int rightSpd = 1000; //left motor speed
-  stepperLeft.setSpeed(leftSpd);//set left motor speed
-  stepperRight.setSpeed(rightSpd);//set right motor speed
+  stepEngine.setSpeed(LEFT, leftSpd);//set left motor speed
+  stepEngine.setSpeed(RIGHT, rightSpd);//set right motor speed
   runAtSpeed();
 }
 
@@ -523,225 +566,119 @@ void move5() {
   Pivots the robot in a given direction by stopping one motor and driving the other
 */
 void pivot(int direction) {
-  int wheelStepsForDistance = (800 / wheelCirc) * ((robotDiam * PI) / 2); // (steps per rotation / distance per rotation) * desired distance
+  PROBE(PROBE_PIVOT);
+  long wheelStepsForDistance = stepsForDistance(fixMul(drive.trackWidth, toFix(PI / 2))); // quarter of the circle around the stopped wheel
+  MotionSegment seg = {};
 
   if (direction == 0){
-    stepperRight.moveTo(wheelStepsForDistance);
-    stepperLeft.moveTo(0);
-    stepperRight.setMaxSpeed(300);//set right motor speed
-    stepperLeft.setMaxSpeed(300);//set left motor speed
-    stepperRight.runSpeedToPosition();//move right motor
-    stepperLeft.runSpeedToPosition();//move left motor
-    runToStop();//run until the robot reaches the target
+    seg.steps[RIGHT] = wheelStepsForDistance;
+    seg.steps[LEFT] = 0;
   } else {
-    stepperRight.moveTo(0);
-    stepperLeft.moveTo(wheelStepsForDistance);
-    stepperRight.setMaxSpeed(300);//set right motor speed
-    stepperLeft.setMaxSpeed(300);//set left motor speed
-    stepperRight.runSpeedToPosition();//move right motor
-    stepperLeft.runSpeedToPosition();//move left motor
-    runToStop();//run until the robot reaches the target
+    seg.steps[RIGHT] = 0;
+    seg.steps[LEFT] = wheelStepsForDistance;
   }
-    stepperRight.setCurrentPosition(0); // Resets stepper motor position to 0
-    stepperLeft.setCurrentPosition(0); // Resets stepper motor position to 0
-  
+  seg.speed[RIGHT] = 300;//set right motor speed
+  seg.speed[LEFT] = 300;//set left motor speed
+  queue_motion(seg);//queue the move, the robot starts as soon as the wheels are free
 }
 
 /*
-  The robot spins in a given direction for a given angle. The two wheels run at equal and opposite velocities
+  The robot spins in a given direction (1 counterclockwise, 0 clockwise) for a given angle. The two wheels run at
+  equal and opposite velocities. With the IMU up the heading hold (HeadingHold.h) stops the spin on the gyro angle
+  in one motion, without it the wheel controller (WheelControl.h) trims the wheels so it ends on the encoder count
 */
 void spin(int direction, int angle) {
+  PROBE(PROBE_SPIN);
 
-  float angle_rad = ((angle) * PI) / 180; // Converts input angle to radians
-
+  // Calculates the distance in encoder ticks for both motors (drive.ticksPerDegree, from the wheel and track sizes or the calibration)
+  fix16 desiredEncoderTicks = ticksForSpin(fixFromInt(angle));
  
-  
-  float wheelStepsForDistance = (800 / wheelCirc) * (robotDiam * (angle_rad)/2); // (steps per rotation / distance per rotation) * desired distance
-
-  // Calculates the distance in encoder ticks for both motors
-  float desiredEncoderTicks = (angle / 3.68); // 3.68 is degrees per pulse for the size of our wheels;
- 
-
   // Calculates the steps needed from encoders
-  float stepsFromEncoder = ((desiredEncoderTicks / 40) * 800);
-
-
-
-  stepperRight.setCurrentPosition(0); // Resets stepper motor position to 0
-  stepperLeft.setCurrentPosition(0);  // Resets stepper motor position to 0
+  long stepsFromEncoder = stepsForSpin(fixFromInt(angle));
 
+  MotionSegment seg = {};
   if (direction == 1){
-    stepperRight.moveTo(stepsFromEncoder); //set motor steps
-    stepperLeft.moveTo(-stepsFromEncoder);  //set motor steps
-    stepperRight.setMaxSpeed(300);//set right motor speed
-    stepperLeft.setMaxSpeed(300);//set left motor speed
-    stepperRight.runSpeedToPosition();//move right motor
-    stepperLeft.runSpeedToPosition();//move left motor
-    runToStop();//run until the robot reaches the target
-
-    
-
-
-    errorLeft = (800/40)*(desiredEncoderTicks - encoder[LEFT]); // Calculates error and adjusts left motor
-    errorRight =(800/40)*(desiredEncoderTicks - encoder[RIGHT]);  // Calculates error and adjusts right motor
-
-        
-    stepperRight.setCurrentPosition(0); // Resets stepper motor position to 0
-    stepperLeft.setCurrentPosition(0);  // Resets stepper motor position to 0
-    stepperRight.setMaxSpeed(300);//set right motor speed
-    stepperLeft.setMaxSpeed(300);//set left motor speed
-    stepperRight.moveTo(errorRight);  // Moves motor to correct for error
-    stepperLeft.moveTo(-errorLeft); // Moves motor to correct for error
-    runToStop();//run until the robot reaches the target
-
-    print_encoder_data(); // Used to troubleshoot and check encoders
-
+    seg.steps[RIGHT] = stepsFromEncoder; //set motor steps
+    seg.steps[LEFT] = -stepsFromEncoder;  //set motor steps
   } else {
-    stepperRight.moveTo(-stepsFromEncoder); //set motor steps
-    stepperLeft.moveTo(stepsFromEncoder); //set motor steps 
-    stepperRight.setMaxSpeed(300);//set right motor speed
-    stepperLeft.setMaxSpeed(300);//set left motor speed
-    stepperRight.runSpeedToPosition();//move right motor
-    stepperLeft.runSpeedToPosition();//move left motor
-    runToStop();//run until the robot reaches the target
-
-    
-
-    Serial.println("Checking for error.....");  // Used to troubleshoot
-    delay(1000);
-    
-    errorLeft = (800/40)*(desiredEncoderTicks - encoder[LEFT]); // Calculates error and adjusts left motor
-    errorRight = (800/40)*(desiredEncoderTicks - encoder[RIGHT]); // Calculates error and adjusts left motor
-
-        
-    stepperRight.setCurrentPosition(0); // Resets stepper motor position to 0
-    stepperLeft.setCurrentPosition(0);  // Resets stepper motor position to 0
-    stepperRight.setMaxSpeed(300);  //set right motor speed
-    stepperLeft.setMaxSpeed(300); //set left motor speed
-    stepperRight.moveTo(-errorRight);
-    stepperLeft.moveTo(errorLeft);
-    runToStop();//run until the robot reaches the target
-
-    print_encoder_data(); // Used to troubleshoot and check encoders
-
-    
-    
+    seg.steps[RIGHT] = -stepsFromEncoder; //set motor steps
+    seg.steps[LEFT] = stepsFromEncoder; //set motor steps 
   }
-  stepperRight.setCurrentPosition(0); // Resets stepper motor position to 0
-  stepperLeft.setCurrentPosition(0);  // Resets stepper motor position to 0
-
-    
-  
+  seg.speed[RIGHT] = 300;//set right motor speed
+  seg.speed[LEFT] = 300;//set left motor speed
+  seg.ticks = desiredEncoderTicks;//encoder ticks the spin should make
+  seg.angle = direction == 1 ? fixFromInt(angle) : -fixFromInt(angle);//counterclockwise positive
+  seg.flags = SEG_HEADING | SEG_CORRECT;//stop on the gyro angle, or the encoder count without a gyro
+  queue_motion(seg);
 }
 
 /*
   Turns the robot based off the input direction. The robot turns at a fixed radius
 */
 void turn(int direction) {
-    int wheelStepsForDistance = (800 / wheelCirc) * ((robotDiam * PI)/2); // (steps per rotation / distance per rotation) * desired distance
-  
-    if (direction == 0){
-    stepperRight.moveTo(wheelStepsForDistance); // Moves stepper
-    stepperLeft.moveTo(wheelStepsForDistance/2); // Moves stepper 
-    stepperRight.setMaxSpeed(300);//set right motor speed
-    stepperLeft.setMaxSpeed(150);//set left motor speed
-    stepperRight.runSpeedToPosition();//move right motor
-    stepperLeft.runSpeedToPosition();//move left motor
-    runToStop();//run until the robot reaches the target
+  PROBE(PROBE_TURN);
+  long wheelStepsForDistance = stepsForDistance(fixMul(drive.trackWidth, toFix(PI / 2))); // (steps per rotation / distance per rotation) * desired distance
+  MotionSegment seg = {};
+
+  if (direction == 0){
+    seg.steps[RIGHT] = wheelStepsForDistance; // Moves stepper
+    seg.steps[LEFT] = wheelStepsForDistance/2; // Moves stepper 
+    seg.speed[RIGHT] = 300;//set right motor speed
+    seg.speed[LEFT] = 150;//set left motor speed
   } else {
-    stepperRight.moveTo(wheelStepsForDistance/2);// Moves stepper
-    stepperLeft.moveTo(wheelStepsForDistance);// Moves stepper
-    stepperRight.setMaxSpeed(150);//set right motor speed
-    stepperLeft.setMaxSpeed(300);//set left motor speed
-    stepperRight.runSpeedToPosition();//move right motor
-    stepperLeft.runSpeedToPosition();//move left motor
-    runToStop();//run until the robot reaches the target
+    seg.steps[RIGHT] = wheelStepsForDistance/2;// Moves stepper
+    seg.steps[LEFT] = wheelStepsForDistance;// Moves stepper
+    seg.speed[RIGHT] = 150;//set right motor speed
+    seg.speed[LEFT] = 300;//set left motor speed
   }
-    stepperRight.setCurrentPosition(0); // Resets stepper motor position to 0
-    stepperLeft.setCurrentPosition(0);  // Resets stepper motor position to 0
-  
+  seg.flags = SEG_LINKED;//keep the 2:1 wheel ratio through the ramps so the radius does not drift
+  queue_motion(seg);
 }
 /*
-  Moves the robot in the forward direction for a given distance
+  Moves the robot in the forward direction for a given distance in Q16.16 cm, negative goes backward.
+  With the IMU up the heading hold (HeadingHold.h) steers the move by the gyro so wheel slip does not turn the robot,
+  without it the wheel controller (WheelControl.h) trims the wheels from the encoders so it ends on the encoder count
 */
-void forward(int distance) {
-  
-  // Calculates the distance in cm to wheel steps  (800  steps per rotation)
-  float wheelStepsForDistance = (800 / wheelCirc) * distance; // (steps per rotation / distance per rotation) * desired distance
+void forwardFix(fix16 distance, float speed) {
 
   // Calculates the distance in encoder ticks for both motors
-  float desiredEncoderTicks = (40 / wheelCirc) * distance;
-  Serial.println(desiredEncoderTicks);// Used to troubleshoot
+  fix16 desiredEncoderTicks = ticksForDistance(distance);
 
   // Calculates the steps needed from encoders
-  float stepsFromEncoder = (desiredEncoderTicks / 40) * 800;
-
-  Serial.println(stepsFromEncoder);// Used to troubleshoot
-
-  stepperRight.setCurrentPosition(0); // Resets stepper motor position to 0
-  stepperLeft.setCurrentPosition(0);  // Resets stepper motor position to 0
-  stepperRight.setMaxSpeed(300);//set right motor speed
-  stepperLeft.setMaxSpeed(300);//set left motor speed
-  stepperRight.moveTo(stepsFromEncoder);
-  stepperLeft.moveTo(stepsFromEncoder);
-  runToStop();//run until the robot reaches the target
-
-
-  errorLeft = desiredEncoderTicks - encoder[LEFT];
-  errorRight = desiredEncoderTicks - encoder[RIGHT];
-
-  Serial.println(errorLeft);  // Used to troubleshoot
-  Serial.println(errorRight);// Used to troubleshoot
-  
-  
-  stepperRight.setCurrentPosition(0);
-  stepperLeft.setCurrentPosition(0);
-  stepperRight.setMaxSpeed(300);//set right motor speed
-  stepperLeft.setMaxSpeed(300);//set left motor speed
-  stepperRight.moveTo(errorRight);
-  stepperLeft.moveTo(errorLeft);
-  runToStop();//run until the robot reaches the target
-
-
-
-  print_encoder_data();// Used to troubleshoot
+  long stepsFromEncoder = stepsForDistance(distance);
+
+  MotionSegment seg = {};
+  seg.steps[RIGHT] = stepsFromEncoder;
+  seg.steps[LEFT] = stepsFromEncoder;
+  seg.speed[RIGHT] = speed;//set right motor speed
+  seg.speed[LEFT] = speed;//set left motor speed
+  seg.ticks = desiredEncoderTicks;//encoder ticks the move should make
+  seg.flags = SEG_HEADING | SEG_CORRECT;//steer by the gyro, or by the encoders without one
+  queue_motion(seg);
+}
 
+/*
+  Moves the robot in the forward direction for a given distance in cm, see forwardFix()
+*/
+void forward(int distance) {
+  PROBE(PROBE_FORWARD);
+  forwardFix(fixFromInt(distance), 300);
 }
 
 
   
 /*
-  Moves the robot in the backwards direction for a given distance
+  Moves the robot in the backwards direction for a given distance in cm, held straight like forward()
 */
 void reverse(int distance) {
-  // Calculates the distance in inches to wheel steps  (200  steps per rotation)
-  int wheelStepsForDistance = (800 / wheelCirc) * distance; // (steps per rotation / distance per rotation) * desired distance
-
-  // Moves both motors to desired distance
- /* long positions[2]; // Array of desired stepper positions
-  positions[0] = -wheelStepsForDistance;//right motor absolute position
-  positions[1] = -wheelStepsForDistance;//left motor absolute position
-  steppers.moveTo(positions);
-  steppers.runSpeedToPosition(); // Blocks until all are in position\\  stepperRight.moveTo(wheelStepsForDistance);
-  stepperLeft.moveTo(wheelStepsForDistance); */
-
-  stepperRight.moveTo(0); // Resets stepper motor position to 0
-  stepperLeft.moveTo(0);  // Resets stepper motor position to 0
-  stepperRight.setMaxSpeed(500);//set right motor speed
-  stepperLeft.setMaxSpeed(500);//set left motor speed
-  stepperRight.runSpeedToPosition();//move right motor
-  stepperLeft.runSpeedToPosition();//move left motor
-  runToStop();//run until the robot reaches the target
+  PROBE(PROBE_REVERSE);
+  forwardFix(-fixFromInt(distance), 500);
 }
 /*
-   Stops the robot
+   Stops the robot, anything still waiting in the motion queue is thrown away
 */
 void stop() {
-  stepperRight.setSpeed(0);//set right motor speed
-  stepperLeft.setSpeed(0);//set left motor speed
-  stepperLeft.stop();//stop left motor
-  stepperRight.stop();//stop right motor
-  
+  motionQueue.clear();//stop both motors and empty the queue
 }
 
 
@@ -751,59 +688,34 @@ void stop() {
   moves the robot in a full circle based off a given diameter and direction
 */
 void moveCircle(int diam, int dir) {
+  PROBE(PROBE_CIRCLE);
 
   // Geometry Calculations needed for stepper motor position
-  int innerDiam = diam - robotDiam; // Inner diameter calculation of inner wheel to circle
-  int outterDiam = diam + robotDiam;  // Outter diameter calculation of outer wheel to circle
+  fix16 innerDiam = fixFromInt(diam) - drive.trackWidth; // Inner diameter calculation of inner wheel to circle
+  fix16 outterDiam = fixFromInt(diam) + drive.trackWidth;  // Outter diameter calculation of outer wheel to circle
 
-  int innerCirc = innerDiam * (PI); // Circum of the Inner Circle by the Inner Wheel
-  int outterCirc = outterDiam * (PI);  // Circum of the Outter Circle by the Outter Wheel
+  long innerTicks = stepsForCircle(innerDiam); // steps around the Inner Circle by the Inner Wheel
+  long outterTicks = stepsForCircle(outterDiam); // steps around the Outter Circle by the Outter Wheel
 
-  float innerTicks = (800 / wheelCirc) * (innerCirc); // (steps per rotation / distance per rotation) * cgghdesired distance
-  float outterTicks = (800 / wheelCirc) * (outterCirc); // (steps per rotation / distance per rotation) * desired distance
-  float circleFactor = innerTicks / outterTicks;  // Makes velocity proportional for the amount of ticks each wheel has to go
+  long outterSpeed = 500;  //  Speed of outter wheel
+  long innerSpeed = (outterSpeed * innerTicks + outterTicks / 2) / outterTicks;  // Speed of inner wheel, proportional to the amount of ticks each wheel has to go
 
-  float outterSpeed = 500;  //  Speed of outter wheel
-  float innerSpeed = circleFactor * 500;  // Speed of inner wheel
-
-  digitalWrite(redLED, HIGH); // Turns redlight on
-
-
-  
+  MotionSegment seg = {};
   if (dir == 0){
-    stepperRight.moveTo(innerTicks);  // Moves Right Stepper motor to desired amount of ticks
-    stepperLeft.moveTo(outterTicks);  // Moves Right Stepper motor to desired amount of ticks
-    stepperRight.setMaxSpeed(innerSpeed);//set right motor speed
-    stepperLeft.setMaxSpeed(outterSpeed);//set left motor speed
-    stepperRight.setSpeed(innerSpeed);//set right motor speed
-    stepperLeft.setSpeed(outterSpeed);//set left motor speed
-    stepperRight.runSpeedToPosition();//move right motor
-    stepperLeft.runSpeedToPosition();//move left motor
-    runToStop();//run until the robot reaches the target
-
-    stepperRight.setCurrentPosition(0); // Resets Stepper postion
-    stepperLeft.setCurrentPosition(0);  // Resets Stepper postion
-    
+    seg.steps[RIGHT] = innerTicks;  // Moves Right Stepper motor to desired amount of ticks
+    seg.steps[LEFT] = outterTicks;  // Moves Right Stepper motor to desired amount of ticks
+    seg.speed[RIGHT] = innerSpeed;//set right motor speed
+    seg.speed[LEFT] = outterSpeed;//set left motor speed
   }
 
   else{
-    stepperRight.moveTo(outterTicks); // Moves Right Stepper motor to desired amount of ticks
-    stepperLeft.moveTo(innerTicks); // Moves Right Stepper motor to desired amount of ticks
-    stepperRight.setMaxSpeed(outterSpeed);//set right motor speed
-    stepperLeft.setMaxSpeed(innerSpeed);//set left motor speed
-    stepperRight.setSpeed(outterSpeed);//set right motor speed
-    stepperLeft.setSpeed(innerSpeed);//set left motor speed
-    stepperRight.runSpeedToPosition();//move right motor
-    stepperLeft.runSpeedToPosition();//move left motor
-    runToStop();//run until the robot reaches the target
-
-    stepperRight.setCurrentPosition(0); // Resets Stepper postion
-    stepperLeft.setCurrentPosition(0);  // Resets Stepper postion
-    
+    seg.steps[RIGHT] = outterTicks; // Moves Right Stepper motor to desired amount of ticks
+    seg.steps[LEFT] = innerTicks; // Moves Right Stepper motor to desired amount of ticks
+    seg.speed[RIGHT] = outterSpeed;//set right motor speed
+    seg.speed[LEFT] = innerSpeed;//set left motor speed
   }
-
-  digitalWrite(redLED, LOW);  // Turns red light off
-  
+  seg.flags = SEG_LINKED;//the step engine keeps the inner/outer ratio exact while accelerating, back to back circles blend
+  queue_motion(seg);
 }
 
 /*
@@ -811,47 +723,45 @@ void moveCircle(int diam, int dir) {
   twice with 2 different direcitons to create a figure 8 with circles of the given diameter.
 */
 void moveFigure8(int diam) {
-
-  digitalWrite(redLED, HIGH);// Turns red light on
-  digitalWrite(ylwLED, HIGH);// Turns ylw light on
-
   moveCircle(diam,0); // Circle Left
-  digitalWrite(redLED, HIGH); // Turns red light on
-  
   moveCircle(diam,1); // Circle Right
-
-  digitalWrite(redLED, LOW);// Turns red light off
-  digitalWrite(ylwLED, LOW);// Turns ylw light off
-
-  
 }
 
+/*
+  Turns the robot by angle degrees in place, positive is clockwise. Angles past half a turn are wrapped so the robot
+  always takes the short way round (270 turns 90 counterclockwise).
+*/
 void goToAngle(int angle){
-  stepperRight.setCurrentPosition(0); // Resets Stepper postion
-  stepperLeft.setCurrentPosition(0);  // Resets Stepper postion
-
+  angle %= 360;
+  if (angle > 180) {
+    angle -= 360;
+  } else if (angle < -180) {
+    angle += 360;
+  }
   if (angle > 0){
     spin(0,angle);  // Spins fastest direction to angle
   }
-  else{
+  else if (angle < 0){
     angle = abs(angle); // Changes sign for angle to be inputed into spin function
     spin(1,angle); // Spins fastest direction to angle
   }
-
 }
 
+/*
+  Drives the robot to the point (x, y) in cm in field coordinates (Odometry.h), the robot started at (0, 0) facing along x.
+  The path follower (PathFollower.h) steers one smooth arc from wherever the robot is when the move starts, so there is
+  no stop to turn first, and it keeps correcting from the pose until the robot is within PURSUIT_TOLERANCE of the goal.
+  Calling it again for the next point of a path works from the pose the robot actually reached, nothing is re-zeroed.
+*/
 void goToGoal(float x, float y){
-  float angle = atan2(y,x) * (180/PI);  // Calculates angle in degrees robot needs to turn
-  goToAngle(angle); // Turns robot to neccessary angle
-
-  x = abs(x); // Change to a positive number for distance calc
-  y = abs(y);// Change to a positive number for distance calc
-  
-  float distance = sqrt((x*x) + (y*y)); // Distance calculation for go to goal
-  
-  forward(distance);  // moves robot to goal point 
-  
-  
+  PROBE(PROBE_GOAL);
+  MotionSegment seg = {};
+  seg.goal[0] = (fix16)(x * FIX_ONE);  // goal in field coordinates
+  seg.goal[1] = (fix16)(y * FIX_ONE);
+  seg.speed[RIGHT] = 300;//top speed of the faster wheel
+  seg.speed[LEFT] = 300;
+  seg.flags = SEG_GOAL;//steer to the goal from the odometry pose
+  queue_motion(seg);
 }
 
 void makeSquare(int side_length){
@@ -862,104 +772,276 @@ void makeSquare(int side_length){
   }
 }
 
-// Troubleshooting function that was often used 
+// Troubleshooting function that was often used, waits for each move so the encoder data lines up with it
 void testEncoders(){
+  long positions[4] = {200, 400, 800, 1600}; // Steps for each test move
   print_encoder_data(); // Troubleshooting
 
-  stepperRight.setCurrentPosition(0); // Resets motor position
-  stepperLeft.setCurrentPosition(0);// Resets motor position
-  stepperRight.setMaxSpeed(300);//set right motor speed
-  stepperLeft.setMaxSpeed(300);//set left motor speed
-  stepperRight.moveTo(200); // New motor position
-  stepperLeft.moveTo(200);// New motor position
-  runToStop();//run until the robot reaches the target
+  for (int i = 0; i < 4; i++){
+    MotionSegment seg = {};
+    seg.steps[RIGHT] = positions[i]; // New motor position
+    seg.steps[LEFT] = positions[i];// New motor position
+    seg.speed[RIGHT] = 300;//set right motor speed
+    seg.speed[LEFT] = 300;//set left motor speed
+    queue_motion(seg);
+    runToStop();//run until the robot reaches the target
 
-  
-  print_encoder_data();// Troubleshooting
-  delay(1000);
+    print_encoder_data();// Troubleshooting
+    delay(1000);
+  }
+}
+
+/*
+  Straight calibration trial (Calibration.h): drives distance cm with the encoder correction off and fits the encoder
+  ticks per wheel rotation from what the encoders counted. Measure how far the robot really went and send it with
+  caldist for the wheel circumference.
+*/
+void calibrate_straight(int distance) {
+  runToStop();//the trial starts from a standstill
+  long steps = stepsForDistance(fixFromInt(distance));
+  EncoderSnapshot start;
+  encoders.snapshot(start);
+
+  MotionSegment seg = {};
+  seg.steps[RIGHT] = steps;
+  seg.steps[LEFT] = steps;
+  seg.speed[RIGHT] = 300;//set right motor speed
+  seg.speed[LEFT] = 300;//set left motor speed
+  queue_motion(seg);//no SEG_CORRECT, the encoders only watch
+  runToStop();
+
+  long ticks[2];
+  encoders.delta(start, ticks);
+  if (!calibration.straightTrial(steps, ticks)) {
+    commandPort->println("straight trial refused");
+  }
+  calibration.print(*commandPort);
+}
 
-  stepperRight.setCurrentPosition(0);// Resets motor position
-  stepperLeft.setCurrentPosition(0);// Resets motor position
-  stepperRight.setMaxSpeed(300);//set right motor speed
-  stepperLeft.setMaxSpeed(300);//set left motor speed
-  stepperRight.moveTo(400);// New motor position
-  stepperLeft.moveTo(400);// New motor position
-  runToStop();//run until the robot reaches the target
+/*
+  Spin calibration trial (Calibration.h): spins turns full turns counterclockwise with the encoder correction off and
+  fits the track width from the angle the gyro saw. An IMU stage that failed at boot is started over here and the
+  boot task takes the gyro zero first, keep the robot still for that second. Without an IMU the robot still spins,
+  measure the angle and send it with calturn.
+*/
+void calibrate_spin(int turns) {
+  runToStop();//the trial starts from a standstill
+  if (!imuReady && boot.state(BOOT_IMU) == BOOT_FAILED) {
+    init_IMU();//try the boot IMU stage again, the boot task resets, sets up and zeroes it without blocking
+  }
+  while (boot.state(BOOT_IMU) == BOOT_RUNNING) {
+    background_tasks();//the boot task is still taking the gyro zero
+  }
+  long steps = stepsForSpin(fixFromInt(360L * turns));
+
+  MotionSegment seg = {};
+  seg.steps[RIGHT] = steps;
+  seg.steps[LEFT] = -steps;
+  seg.speed[RIGHT] = 300;//set right motor speed
+  seg.speed[LEFT] = 300;//set left motor speed
+  odometry.update();//take the samples from before the spin out of the count
+  gyroYaw = 0;
+  queue_motion(seg);//no SEG_CORRECT, the encoders would stop it on the angle the old track width gives
+  runToStop();
+
+  //the odometry adds up the yaw rate as it reads the gyro, 100 ms more for the robot to settle
+  unsigned long settled = millis();
+  while (millis() - settled < 100) {
+    background_tasks();
+  }
+  float degrees = gyroYaw / IMU_GYRO_LSB / IMU_SAMPLE_HZ;
 
-  print_encoder_data();// Troubleshooting
-  delay(1000);
+  calibration.spinTrial(steps);//keeps the steps for calturn, the track width only changes with a fit
+  if (!imuReady) {
+    commandPort->println("no IMU, send the angle turned with calturn");
+  } else {
+    commandPort->print("gyro angle: ");
+    commandPort->println(degrees);
+    if (!calibration.fitSpin(steps, degrees)) {
+      commandPort->println("spin trial refused");
+    }
+  }
+  calibration.print(*commandPort);
+}
 
+// Remote control commands, each one calls a motion function with the numbers that came with it
+void command_forward(const int *args) { forward(args[0]); }
+void command_reverse(const int *args) { reverse(args[0]); }
+void command_spin(const int *args) { spin(args[0], args[1]); }
+void command_turn(const int *args) { turn(args[0]); }
+void command_pivot(const int *args) { pivot(args[0]); }
+void command_circle(const int *args) { moveCircle(args[0], args[1]); }
+void command_fig8(const int *args) { moveFigure8(args[0]); }
+void command_goto(const int *args) { goToGoal(args[0], args[1]); }
+void command_angle(const int *args) { goToAngle(args[0]); }
+void command_square(const int *args) { makeSquare(args[0]); }
+void command_stop(const int *args) { stop(); }
+void command_probes(const int *args) { probesPrint(*commandPort); }
+void command_boot(const int *args) { boot.print(*commandPort); }
+void command_tasks(const int *args) { scheduler.print(*commandPort); }
+void command_telem(const int *args) { telemetry.setRate(args[0], max(args[1], 0)); }
+void command_calfwd(const int *args) { calibrate_straight(args[0]); }
+void command_caldist(const int *args) {
+  if (!calibration.fitDistance(args[0] / 10.0)) {
+    commandPort->println("distance refused, run calfwd first");
+  }
+  calibration.print(*commandPort);
+}
+void command_calspin(const int *args) { calibrate_spin(args[0]); }
+void command_calturn(const int *args) {
+  if (!calibration.fitSpin(0, args[0])) {
+    commandPort->println("angle refused, run calspin first");
+  }
+  calibration.print(*commandPort);
+}
+void command_calsave(const int *args) { calibration.save(); calibration.print(*commandPort); }
+void command_calshow(const int *args) { calibration.print(*commandPort); }
+void command_caldef(const int *args) { calibration.reset(); calibration.print(*commandPort); }
+
+//command table: verb, number of arguments, function
+const Command commandTable[] = {
+  {"forward", 1, command_forward},   //forward cm;
+  {"reverse", 1, command_reverse},   //reverse cm;
+  {"spin", 2, command_spin},         //spin direction degrees;
+  {"turn", 1, command_turn},         //turn direction;
+  {"pivot", 1, command_pivot},       //pivot direction;
+  {"circle", 2, command_circle},     //circle diameter direction;
+  {"fig8", 1, command_fig8},         //fig8 diameter;
+  {"goto", 2, command_goto},         //goto x y; field coordinates in cm
+  {"angle", 1, command_angle},       //angle degrees;
+  {"square", 1, command_square},     //square side;
+  {"stop", 0, command_stop},         //stop;
+  {"probes", 0, command_probes},     //probes; timing probe table since the last query (Probes.h)
+  {"boot", 0, command_boot},         //boot; startup stages, the time each took and the reset cause (Boot.h)
+  {"tasks", 0, command_tasks},       //tasks; scheduler task runs, missed deadlines and run times since the last query
+  {"telem", 2, command_telem},       //telem channel hz; telemetry channel rate, 0 off (Telemetry.h), replies move into the stream
+  {"calfwd", 1, command_calfwd},     //calfwd cm; straight calibration trial (Calibration.h)
+  {"caldist", 1, command_caldist},   //caldist mm; distance the last calfwd really covered
+  {"calspin", 1, command_calspin},   //calspin turns; spin calibration trial, gyro angle
+  {"calturn", 1, command_calturn},   //calturn degrees; angle the last calspin really turned
+  {"calsave", 0, command_calsave},   //calsave; keep the calibration in EEPROM
+  {"calshow", 0, command_calshow},   //calshow; calibration in use
+  {"caldef", 0, command_caldef},     //caldef; back to RobotConfig.h, EEPROM copy erased
+};
+
+// Scheduler tasks, the task table below sets how often each one runs (Scheduler.h)
+//function to start queued moves as the wheels free up and end them once the controllers below are done
+void motion_task() {
+  motionQueue.service();
+}
 
-  stepperRight.setCurrentPosition(0);// Resets motor position
-  stepperLeft.setCurrentPosition(0);// Resets motor position
-  stepperRight.setMaxSpeed(300);//set right motor speed
-  stepperLeft.setMaxSpeed(300);//set left motor speed
-  stepperRight.moveTo(800);// New motor position
-  stepperLeft.moveTo(800);// New motor position
-  runToStop();//run until the robot reaches the target
+//function to trim the wheel speeds by the encoders while a SEG_CORRECT segment runs
+void wheel_task() {
+  wheelControl.update();
+}
 
-  print_encoder_data();// Troubleshooting
-  delay(1000);
-    
+//function to steer by the gyro while a SEG_HEADING segment runs
+void heading_task() {
+  headingHold.update();
+}
 
-  stepperRight.setCurrentPosition(0);// Resets motor position
-  stepperLeft.setCurrentPosition(0);// Resets motor position
-  stepperRight.setMaxSpeed(300);//set right motor speed
-  stepperLeft.setMaxSpeed(300);//set left motor speed
-  stepperRight.moveTo(1600);// New motor position
-  stepperLeft.moveTo(1600);// New motor position
-  runToStop();//run until the robot reaches the target
+//function to steer toward the goal while a SEG_GOAL segment runs
+void pursuit_task() {
+  pathFollower.update();
+}
 
-  print_encoder_data();// Troubleshooting
+//function to move the robot pose on, the gyro samples the IMU interrupt has buffered are read here too
+void odometry_task() {
+  odometry.update();
 }
 
+//function to run the commands waiting on the serial monitor and Bluetooth once the boot is far enough along
+void comms_task() {
+  if (boot.commandsReady()) {
+    Bluetooth_comm();
+  }
+}
+
+//function to send the telemetry channels that are due
+void telemetry_task() {
+  telemetry.update();
+}
+
+//function to run the demo moves and data prints, every wait_time
+void report_task() {
+  //uncomment each function one at a time to see what the code does
+  //move1();//call move back and forth function
+  //move2();//call move back and forth function with AccelStepper library functions
+  //move3();//call move back and forth function with MultiStepper library functions
+  //move4(); //move to target position with 2 different speeds
+  //move5(); //move continuously with 2 different speeds
+
+  //Uncomment to read Encoder Data (uncomment to read on serial monitor)
+  //print_encoder_data();   //prints encoder data
+
+  //Uncomment to read IMU Data (uncomment to read on serial monitor, leave the telemetry channels off in setup())
+  //print_IMU_data();         //print IMU data
+}
+
+//task table: name, function, period in us (0 every pass), run in this order on each pass
+const Task taskTable[] = {
+  {"encoder", update_encoder_data, 0},             //wheel speeds from the tick times, fresh for the controllers
+  {"motion", motion_task, 0},                       //motion queue, chains segments on time
+  {"wheel", wheel_task, CONTROL_PERIOD_US},         //encoder PID, 200 Hz
+  {"odometry", odometry_task, ODOMETRY_PERIOD_US},  //pose and gyro, 50 Hz
+  {"heading", heading_task, HEADING_PERIOD_US},     //gyro heading hold, right after the odometry it reads
+  {"pursuit", pursuit_task, PURSUIT_PERIOD_US},     //pure pursuit, right after the odometry it reads
+  {"boot", boot_service, 10000},                    //startup stages still running, IMU bring-up
+  {"comms", comms_task, 10000},                     //commands, 10 ms of 9600 baud is 10 bytes, well inside the 64 byte serial buffers
+  {"telem", telemetry_task, 5000},                  //telemetry channels at up to 200 Hz
+  {"report", report_task, wait_time * 1000UL},      //demo moves and data prints
+};
 
 //// MAIN
 void setup()
 {
-  delay(5000);
+  boot.begin(); //time zero of the staged startup, nothing in here waits (Boot.h)
   int baudrate = 9600; //serial monitor baud rate'
-  int BTbaud = 9600;  // HC-05 default speed in AT command more
+  unsigned long BTbaud = BT_DEFAULT_BAUD;  // HC-05 default speed in data mode, raise it here and with AT+UART
+  calibration.load(); //measured wheel geometry from EEPROM, RobotConfig.h values when none was saved
+
+  boot.start(BOOT_STEPPERS);
   init_stepper(); //set up stepper motor
+  boot.finish(BOOT_STEPPERS, true);
 
-  attachInterrupt(digitalPinToInterrupt(ltEncoder), LwheelSpeed, CHANGE);    //init the interrupt mode for the left encoder
-  attachInterrupt(digitalPinToInterrupt(rtEncoder), RwheelSpeed, CHANGE);   //init the interrupt mode for the right encoder
+  boot.start(BOOT_ENCODERS);
+  probesBegin();      //cycle counter for the timing probes (Probes.h)
+  encoders.begin();   //attach the encoder interrupts
+  odometry.begin();   //the robot starts at (0, 0) facing along the x axis
+  motionQueue.begin();   //motion functions queue their moves from here on
+  boot.finish(BOOT_ENCODERS, true);
 
-  //BTSerial.begin(BTbaud);     //start Bluetooth communication
+  boot.start(BOOT_COMMS);     //boot_service() finishes it once the serial port is up
+  bluetooth.begin(BTbaud);     //start Bluetooth communication
   Serial.begin(baudrate);     //start serial monitor communication
 
-  while (!Serial)
-    delay(10); // will pause until serial console opens
+  telemetry.begin(Serial);   //binary telemetry, every channel is off until its rate is set
+  //Uncomment to stream telemetry instead of the text prints, or send telem channel hz; (decode on the computer with
+  //tools/telemetry_decode.py, command replies come through it as text while a channel is on)
+  //telemetry.setRate(TELEMETRY_ENCODERS, 20);
+  //telemetry.setRate(TELEMETRY_IMU, 20);
+  //telemetry.setRate(TELEMETRY_STEPPERS, 10);
+  //telemetry.setRate(TELEMETRY_POSE, 10);
   
   //init_BT(); //initialize Bluetooth
+  serialCommands.begin(commandTable, sizeof(commandTable) / sizeof(commandTable[0]));
+  bluetoothCommands.begin(commandTable, sizeof(commandTable) / sizeof(commandTable[0]));
 
-  //init_IMU(); //initialize IMU
+  init_IMU(); //find the IMU, service_IMU() sets it up and takes the gyro zero
+  scheduler.begin(taskTable, sizeof(taskTable) / sizeof(taskTable[0])); //every task runs on the first pass of loop()
   
-  Serial.println("Robot starting...");
-  Serial.println("");
-  delay(pauseTime); //always wait 2.5 seconds before the robot moves
+#ifdef KINEMATICS_BENCHMARK
+  benchmark_kinematics(); //compare the float and fixed point motion math
+#endif
+#ifdef PROFILE_BENCHMARK
+  profileBegin(); //Timer5 cycle counter for the ISR and loop() timing
+  benchmark_step_rate(); //highest step rate each wheel keeps up with
+#endif
 }
 
 
 void loop()
 {
- 
-
-  //uncomment each function one at a time to see what the code does
-  //move1();//call move back and forth function
-  //move2();//call move back and forth function with AccelStepper library functions
-  //move3();//call move back and forth function with MultiStepper library functions
-  //move4(); //move to target position with 2 different speeds
-  //move5(); //move continuously with 2 different speeds
-
-  //Uncomment to read Encoder Data (uncomment to read on serial monitor)
-  //print_encoder_data();   //prints encoder data
-
-  //Uncomment to read IMU Data (uncomment to read on serial monitor)
-  //print_IMU_data();         //print IMU data
-
-  //Uncomment to Send and Receive with Bluetooth
-  //Bluetooth_comm();
-
-  delay(wait_time);               //wait to move robot or read data
-}
\ No newline at end of file
+  PROFILE_LOOP();                 //time this pass, prints the profile report when it is due (PROFILE_BENCHMARK only)
+  scheduler.run();                //every task that is due, see the task table above setup()
+}
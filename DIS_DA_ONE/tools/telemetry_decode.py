@@ -0,0 +1,129 @@
+"""
+  telemetry_decode.py
+  Kyzer Bowen, Tyce Miller
+
+  Host side decoder for the binary telemetry stream in Telemetry.h. Reads COBS frames from the serial port (or a
+  capture file), checks the CRC and prints one line per packet. Lost frames show up as gaps in the sequence numbers.
+  Text packets (command replies while a channel streams) are put back together and printed a line at a time.
+
+  python tools/telemetry_decode.py COM5 9600
+  python tools/telemetry_decode.py capture.bin
+
+  Needs pyserial for a serial port (PlatformIO already installs it).
+"""
+
+import binascii
+import struct
+import sys
+
+IMU_GYRO_LSB = 65.5      # counts per degree/s, Imu.h
+IMU_ACCEL_LSB = 4096.0   # counts per g, Imu.h
+FIX_ONE = 65536.0        # Q16.16
+
+# channel id -> (name, payload format, function to turn the unpacked values into a dict)
+CHANNELS = {
+    0: ("encoders", "<llll", lambda v: {
+        "ticksLeft": v[0], "ticksRight": v[1],
+        "speedLeft": v[2] / FIX_ONE, "speedRight": v[3] / FIX_ONE}),
+    1: ("imu", "<hhhhhhhH", lambda v: {
+        "accel": [round(a / IMU_ACCEL_LSB, 3) for a in v[0:3]],
+        "temperature": round(v[3] / 340.0 + 36.53, 2),
+        "gyro": [round(g / IMU_GYRO_LSB, 2) for g in v[4:7]],
+        "lost": v[7]}),
+    2: ("steppers", "<llll", lambda v: {
+        "positionLeft": v[0], "positionRight": v[1],
+        "toGoLeft": v[2], "toGoRight": v[3]}),
+    3: ("pose", "<lll", lambda v: {
+        "x": round(v[0] / FIX_ONE, 2), "y": round(v[1] / FIX_ONE, 2),
+        "heading": round(v[2] / FIX_ONE, 2)}),
+}
+TEXT_CHANNEL = 4         # TELEMETRY_TEXT, any length up to TELEMETRY_MAX_PAYLOAD
+
+
+def cobs_decode(frame):
+    """Undo the COBS stuffing of one frame (without its 0 delimiter), None if it is malformed."""
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame) + 1:
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def decode(packet):
+    """Check the CRC and unpack one packet, None if it is damaged or unknown."""
+    if len(packet) < 8:
+        return None
+    body, crc = packet[:-2], struct.unpack("<H", packet[-2:])[0]
+    if binascii.crc_hqx(body, 0) != crc:   # crc_hqx with 0 start is CRC-16/XMODEM
+        return None
+    channel, sequence, millis = struct.unpack("<BBL", body[:6])
+    if channel == TEXT_CHANNEL:
+        return "text", sequence, millis, body[6:].decode("ascii", "replace")
+    if channel not in CHANNELS:
+        return None
+    name, layout, convert = CHANNELS[channel]
+    if len(body) - 6 != struct.calcsize(layout):
+        return None
+    return name, sequence, millis, convert(struct.unpack(layout, body[6:]))
+
+
+def frames(stream, live):
+    """Split a byte stream on the 0 delimiters, yields each frame without it. A live port keeps waiting for bytes."""
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(64)
+        if not chunk:
+            if live:
+                continue
+            return
+        for byte in chunk:
+            if byte == 0:
+                yield bytes(buffer)
+                buffer.clear()
+            else:
+                buffer.append(byte)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return
+    if len(sys.argv) > 2:
+        import serial
+        stream = serial.Serial(sys.argv[1], int(sys.argv[2]), timeout=0.1)
+    else:
+        stream = open(sys.argv[1], "rb")
+
+    lastSequence = {}
+    line = ""
+    bad = 0
+    for frame in frames(stream, len(sys.argv) > 2):
+        packet = cobs_decode(frame)
+        result = decode(packet) if packet else None
+        if result is None:
+            bad += 1   # first partial frame, text output or line noise
+            continue
+        name, sequence, millis, values = result
+        if name in lastSequence:
+            lost = (sequence - lastSequence[name] - 1) & 0xFF
+            if lost:
+                print("%10d %-9s %d frames lost" % (millis, name, lost))
+        lastSequence[name] = sequence
+        if name == "text":
+            line += values
+            if line.endswith("\n"):
+                print("%10d %-9s %s" % (millis, name, line.rstrip()))
+                line = ""
+            continue
+        print("%10d %-9s %s" % (millis, name, values))
+    print("%d damaged frames" % bad)
+
+
+if __name__ == "__main__":
+    main()